@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""Compare two results files written by './a.out bench <results.json>' and flag regressions.
+
+Usage: compare_benchmarks.py baseline.json current.json [--threshold 0.10]
+
+Exits with status 1 if any benchmark is slower than the baseline by more than the threshold
+or is missing from the current results.
+"""
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        return {(r["name"], r["size"]): r for r in json.load(f)}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.10, help="relative slowdown considered a regression")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+    regressions = 0
+    print(f"{'benchmark':36} {'size':>10} {'baseline':>10} {'current':>10} {'change':>8}")
+    for key, result in current.items():
+        if key not in baseline:
+            continue
+        before = baseline[key]["ns_per_op"]
+        after = result["ns_per_op"]
+        #a baseline that rounded down to 0 ns has no relative change, any time above it is a regression
+        if before > 0:
+            change = after / before - 1
+        else:
+            change = 0.0 if after <= 0 else float("inf")
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{key[0]:36} {key[1]:>10} {before:>10.3f} {after:>10.3f} {change:>+8.1%}{flag}")
+
+    missing = [key for key in baseline if key not in current]
+    for key in missing:
+        print(f"{key[0]:36} {key[1]:>10} {baseline[key]['ns_per_op']:>10.3f} {'-':>10} {'-':>8}  MISSING")
+
+    if regressions:
+        print(f"{regressions} regression(s) beyond {args.threshold:.0%}")
+    if missing:
+        print(f"{len(missing)} benchmark(s) missing from {args.current}")
+    if regressions or missing:
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,8 +1,35 @@
 #include <stdint.h>
+#include <stddef.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <math.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <poll.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 /**
  * @brief data structure to represent an IP address in dotted decimal notation
@@ -43,13 +70,324 @@ typedef struct {
 } subnet_t;
 
 
+/*
+ * Compile-time subnet calculations
+ * 
+ * Constant-expression equivalents of 'subnet_calculator' and 'calculate_subnet_prefixlen', so that address plans known
+ * at build time (management ranges, reserved blocks...) are calculated by the compiler and validated with static
+ * assertions: an invalid plan does not compile.
+ */
+#define IPV4(byte1, byte2, byte3, byte4) ((uint32_t)(byte1) << 24 | (uint32_t)(byte2) << 16 | (uint32_t)(byte3) << 8 | (uint32_t)(byte4))
+#define SUBNET_MASK(prefixlen) ((prefixlen) == 0 ? (uint32_t)0 : (uint32_t)(0xFFFFFFFF << (32 - (prefixlen))))
+#define SUBNET_NETWORK_ADDRESS(ip_address, prefixlen) ((uint32_t)(ip_address) & SUBNET_MASK(prefixlen))
+#define SUBNET_BROADCAST_ADDRESS(ip_address, prefixlen) ((uint32_t)(ip_address) | ~SUBNET_MASK(prefixlen))
+#define SUBNET_NEXT_NETWORK(ip_address, prefixlen) ((uint32_t)(SUBNET_BROADCAST_ADDRESS(ip_address, prefixlen) + 1))
+#define SUBNET_NUM_IP_ADDRESSES(prefixlen) ((uint32_t)(~SUBNET_MASK(prefixlen) + 1))
+//smallest subnet that can contain 'num_ip_addresses' hosts, same as 'calculate_subnet_prefixlen'
+#define SUBNET_PREFIXLEN_FOR_HOSTS(num_ip_addresses) (__builtin_clz((uint32_t)(num_ip_addresses) + 1))
+#define SUBNET_IS_ALIGNED(ip_address, prefixlen) (((uint32_t)(ip_address) & ~SUBNET_MASK(prefixlen)) == 0)
+#define SUBNET_CONTAINS(parent_address, parent_prefixlen, ip_address, prefixlen) \
+    ((prefixlen) >= (parent_prefixlen) && SUBNET_NETWORK_ADDRESS(ip_address, parent_prefixlen) == SUBNET_NETWORK_ADDRESS(parent_address, parent_prefixlen))
+
+/**
+ * @brief Initializer of a constant subnet_t, equivalent to 'subnet_calculator(ip_address, prefixlen)'
+ */
+#define SUBNET(address, length) { \
+    .network_address = SUBNET_NETWORK_ADDRESS(address, length), \
+    .broadcast_address = SUBNET_BROADCAST_ADDRESS(address, length), \
+    .first_address = SUBNET_NETWORK_ADDRESS(address, length) + 1, \
+    .last_address = SUBNET_BROADCAST_ADDRESS(address, length) - 1, \
+    .next_network = SUBNET_NEXT_NETWORK(address, length), \
+    .subnet_mask = SUBNET_MASK(length), \
+    .num_ip_addresses = SUBNET_NUM_IP_ADDRESSES(length), \
+    .prefixlen = (length) \
+}
+
+/**
+ * @brief Fail to compile unless the subnet is a valid allocation inside the pool: aligned to its size and contained in the pool
+ */
+#define STATIC_ASSERT_SUBNET_IN_POOL(pool_address, pool_prefixlen, ip_address, prefixlen) \
+    _Static_assert(SUBNET_IS_ALIGNED(ip_address, prefixlen), "subnet not aligned to its size"); \
+    _Static_assert(SUBNET_CONTAINS(pool_address, pool_prefixlen, ip_address, prefixlen), "subnet out of the pool")
+
+
+/**
+ * @brief data structure to represent the parameters that only depend on the prefix length of a subnet
+ */
+typedef struct {
+    uint32_t subnet_mask;
+    uint32_t host_mask;
+    uint64_t num_ip_addresses;
+} prefix_params_t;
+
+#define PREFIX_PARAMS(prefixlen) {SUBNET_MASK(prefixlen), ~SUBNET_MASK(prefixlen), (uint64_t)1 << (32 - (prefixlen))}
+
+/**
+ * @brief Parameters of each prefix length from /0 to /32, precomputed to avoid variable shifts in the calculations
+ */
+const prefix_params_t prefix_table[33] = {
+    PREFIX_PARAMS(0), PREFIX_PARAMS(1), PREFIX_PARAMS(2), PREFIX_PARAMS(3), PREFIX_PARAMS(4), PREFIX_PARAMS(5), PREFIX_PARAMS(6),
+    PREFIX_PARAMS(7), PREFIX_PARAMS(8), PREFIX_PARAMS(9), PREFIX_PARAMS(10), PREFIX_PARAMS(11), PREFIX_PARAMS(12), PREFIX_PARAMS(13),
+    PREFIX_PARAMS(14), PREFIX_PARAMS(15), PREFIX_PARAMS(16), PREFIX_PARAMS(17), PREFIX_PARAMS(18), PREFIX_PARAMS(19), PREFIX_PARAMS(20),
+    PREFIX_PARAMS(21), PREFIX_PARAMS(22), PREFIX_PARAMS(23), PREFIX_PARAMS(24), PREFIX_PARAMS(25), PREFIX_PARAMS(26), PREFIX_PARAMS(27),
+    PREFIX_PARAMS(28), PREFIX_PARAMS(29), PREFIX_PARAMS(30), PREFIX_PARAMS(31), PREFIX_PARAMS(32)
+};
+
+/*
+ * Hot-path instrumentation
+ * 
+ * Each thread counts the operations it performs in its own cache-line aligned slot, so that threads never share
+ * cache lines, and the latency of one in every 2^INSTRUMENTATION_SAMPLE_SHIFT operations is recorded in a log-linear
+ * (HDR-style) histogram with 8 sub-buckets per power of 2. The slots are aggregated on demand.
+ * 
+ * It is disabled by default, so that it does not slow down the hot paths and their benchmarks: compile with
+ * -DINSTRUMENTATION to enable it.
+ */
+typedef enum {
+    OP_SUBNET_CALCULATOR,
+    OP_VLSM,
+    OP_LPM_LOOKUP,
+    OP_LPM_LOOKUP_BATCH,
+    OP_ACL_CLASSIFY,
+    OP_FREE_SPACE_ALLOCATE,
+    NUM_OPS
+} op_t;
+
+const char* op_names[NUM_OPS] = {"subnet_calculator", "vlsm", "lpm_lookup", "lpm_lookup_batch", "acl_classify", "free_space_allocate"};
+
+#define INSTRUMENTATION_SAMPLE_SHIFT 6
+#define LATENCY_SUB_BUCKET_BITS 3
+#define LATENCY_NUM_BUCKETS (64 << LATENCY_SUB_BUCKET_BITS)
+#define MAX_INSTRUMENTED_THREADS 1024
+
+typedef struct {
+    uint64_t counts[NUM_OPS];
+    uint64_t latency_histograms[NUM_OPS][LATENCY_NUM_BUCKETS];
+} __attribute__((aligned(64))) op_stats_t;
+
+op_stats_t* op_stats_slots[MAX_INSTRUMENTED_THREADS];
+//a slot is owned by one thread at a time, and handed over with its counters to a new thread when its owner exits
+int op_stats_slot_owned[MAX_INSTRUMENTED_THREADS];
+int num_op_stats_slots = 0;
+//shared by the threads that find no slot, its counters are approximate as they race
+op_stats_t op_stats_overflow_slot;
+pthread_key_t op_stats_slot_key;
+pthread_once_t op_stats_slot_key_once = PTHREAD_ONCE_INIT;
+_Thread_local op_stats_t* thread_op_stats = NULL;
+
+__attribute__((noinline, cold)) uint64_t now_nanoseconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Bucket of the latency histogram: values below 8 have their own bucket, then 8 buckets per power of 2
+ */
+int latency_bucket(uint64_t nanoseconds) {
+    if (nanoseconds < (1 << LATENCY_SUB_BUCKET_BITS)) {
+        return nanoseconds;
+    }
+    int exponent = 63 - __builtin_clzll(nanoseconds);
+    int sub_bucket = nanoseconds >> (exponent - LATENCY_SUB_BUCKET_BITS) & ((1 << LATENCY_SUB_BUCKET_BITS) - 1);
+    return (exponent - LATENCY_SUB_BUCKET_BITS + 1) << LATENCY_SUB_BUCKET_BITS | sub_bucket;
+}
+
+/**
+ * @brief Smallest latency of a bucket, inverse of 'latency_bucket'
+ */
+uint64_t latency_bucket_value(int bucket) {
+    if (bucket < (1 << LATENCY_SUB_BUCKET_BITS)) {
+        return bucket;
+    }
+    int exponent = (bucket >> LATENCY_SUB_BUCKET_BITS) + LATENCY_SUB_BUCKET_BITS - 1;
+    uint64_t sub_bucket = bucket & ((1 << LATENCY_SUB_BUCKET_BITS) - 1);
+    return ((uint64_t)1 << exponent) | sub_bucket << (exponent - LATENCY_SUB_BUCKET_BITS);
+}
+
+void release_op_stats_slot(void* slot) {
+    __atomic_store_n(&op_stats_slot_owned[(intptr_t)slot - 1], 0, __ATOMIC_RELEASE);
+}
+
+void create_op_stats_slot_key() {
+    pthread_key_create(&op_stats_slot_key, release_op_stats_slot);
+}
+
+/**
+ * @brief Give the calling thread a slot, reusing the one of an exited thread if possible
+ */
+__attribute__((noinline, cold)) op_stats_t* register_op_stats_slot() {
+    pthread_once(&op_stats_slot_key_once, create_op_stats_slot_key);
+    int num_slots = __atomic_load_n(&num_op_stats_slots, __ATOMIC_RELAXED);
+    int slot = -1;
+    for (int i = 0; i < num_slots && i < MAX_INSTRUMENTED_THREADS && slot < 0; i++){
+        int owned = 0;
+        if (__atomic_load_n(&op_stats_slots[i], __ATOMIC_ACQUIRE) != NULL
+            && __atomic_compare_exchange_n(&op_stats_slot_owned[i], &owned, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        slot = __atomic_fetch_add(&num_op_stats_slots, 1, __ATOMIC_RELAXED);
+        if (slot >= MAX_INSTRUMENTED_THREADS) {
+            thread_op_stats = &op_stats_overflow_slot;
+            return thread_op_stats;
+        }
+        op_stats_t* stats = aligned_alloc(64, sizeof(op_stats_t));
+        memset(stats, 0, sizeof(op_stats_t));
+        op_stats_slot_owned[slot] = 1;
+        __atomic_store_n(&op_stats_slots[slot], stats, __ATOMIC_RELEASE);
+    }
+    thread_op_stats = op_stats_slots[slot];
+    pthread_setspecific(op_stats_slot_key, (void*)(intptr_t)(slot + 1));
+    return thread_op_stats;
+}
+
+/**
+ * @brief Add a sampled operation that started at 'start' to the latency histogram of the thread
+ */
+__attribute__((noinline, cold)) void record_latency(op_t op, uint64_t start) {
+    uint64_t* bucket = &thread_op_stats->latency_histograms[op][latency_bucket(now_nanoseconds() - start)];
+    __atomic_store_n(bucket, *bucket + 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * The fast path of the instrumentation is inlined, everything else (registering the slot of the thread, reading
+ * the clock) is kept out of line so that instrumented functions can still be inlined and keep their register allocation
+ */
+/**
+ * @brief Count an operation and, if it is sampled, return the time it starts (0 otherwise)
+ */
+static inline uint64_t instrument_begin(op_t op) {
+    op_stats_t* stats = thread_op_stats;
+    if (__builtin_expect(stats == NULL, 0)) {
+        stats = register_op_stats_slot();
+    }
+    //only this thread writes the slot, relaxed atomics just keep the concurrent reads of the aggregation well defined
+    uint64_t count = stats->counts[op] + 1;
+    __atomic_store_n(&stats->counts[op], count, __ATOMIC_RELAXED);
+    if (__builtin_expect((count & ((1 << INSTRUMENTATION_SAMPLE_SHIFT) - 1)) == 0, 0)) {
+        return now_nanoseconds();
+    }
+    return 0;
+}
+
+static inline void instrument_end(op_t op, uint64_t start) {
+    if (__builtin_expect(start != 0, 0)) {
+        record_latency(op, start);
+    }
+}
+
+#ifdef INSTRUMENTATION
+#define INSTRUMENT_BEGIN(op) uint64_t instrument_start_ = instrument_begin(op)
+#define INSTRUMENT_END(op) instrument_end(op, instrument_start_)
+#else
+#define INSTRUMENT_BEGIN(op)
+#define INSTRUMENT_END(op)
+#endif
+
+void add_op_stats(op_stats_t* total, op_stats_t* stats) {
+    for (int op = 0; op < NUM_OPS; op++){
+        total->counts[op] += __atomic_load_n(&stats->counts[op], __ATOMIC_RELAXED);
+        for (int bucket = 0; bucket < LATENCY_NUM_BUCKETS; bucket++){
+            total->latency_histograms[op][bucket] += __atomic_load_n(&stats->latency_histograms[op][bucket], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * @brief Sum the counters and histograms of all the threads
+ */
+void aggregate_op_stats(op_stats_t* total) {
+    memset(total, 0, sizeof(op_stats_t));
+    int num_slots = __atomic_load_n(&num_op_stats_slots, __ATOMIC_RELAXED);
+    for (int i = 0; i < num_slots && i < MAX_INSTRUMENTED_THREADS; i++){
+        op_stats_t* stats = __atomic_load_n(&op_stats_slots[i], __ATOMIC_ACQUIRE);
+        if (stats != NULL) {
+            add_op_stats(total, stats);
+        }
+    }
+    add_op_stats(total, &op_stats_overflow_slot);
+}
+
+/**
+ * @brief Latency below which are 'percentile'% of the sampled operations
+ */
+uint64_t latency_percentile(const uint64_t histogram[], double percentile) {
+    uint64_t num_samples = 0;
+    for (int bucket = 0; bucket < LATENCY_NUM_BUCKETS; bucket++){
+        num_samples += histogram[bucket];
+    }
+    uint64_t rank = num_samples * percentile / 100, seen = 0;
+    for (int bucket = 0; bucket < LATENCY_NUM_BUCKETS; bucket++){
+        seen += histogram[bucket];
+        if (seen > rank) {
+            return latency_bucket_value(bucket);
+        }
+    }
+    return 0;
+}
+
+void print_op_stats() {
+    static op_stats_t total;
+    aggregate_op_stats(&total);
+    printf("%-20s %14s %10s %10s %10s\n", "operation", "count", "p50 ns", "p99 ns", "p99.9 ns");
+    for (int op = 0; op < NUM_OPS; op++){
+        printf("%-20s %14" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n", op_names[op], total.counts[op],
+            latency_percentile(total.latency_histograms[op], 50),
+            latency_percentile(total.latency_histograms[op], 99),
+            latency_percentile(total.latency_histograms[op], 99.9));
+    }
+}
+
+/*
+ * USDT probes for bpftrace and perf, see probes.bt
+ * 
+ * When <sys/sdt.h> (systemtap-sdt-dev) is available each probe is a nop in the binary plus a note describing where to
+ * find its arguments. Arguments that are expensive to calculate, such as durations, are only calculated while a tracer
+ * is attached to the probe, which the tracer signals by incrementing the semaphore of the probe.
+ * 
+ * Compile with -DNO_USDT to remove them.
+ */
+#if !defined(NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define USDT_PROBES 1
+#endif
+#endif
+
+#ifdef USDT_PROBES
+#define PROBE_SEMAPHORE(name) __extension__ unsigned short subnet_calculator_##name##_semaphore __attribute__((unused, section(".probes")))
+#define PROBE_IS_ENABLED(name) __builtin_expect(subnet_calculator_##name##_semaphore != 0, 0)
+#define PROBE2(name, arg1, arg2) DTRACE_PROBE2(subnet_calculator, name, arg1, arg2)
+#define PROBE3(name, arg1, arg2, arg3) DTRACE_PROBE3(subnet_calculator, name, arg1, arg2, arg3)
+#else
+#define PROBE_SEMAPHORE(name) extern int subnet_calculator_##name##_semaphore
+#define PROBE_IS_ENABLED(name) 0
+#define PROBE2(name, arg1, arg2) ((void)(arg1), (void)(arg2))
+#define PROBE3(name, arg1, arg2, arg3) ((void)(arg1), (void)(arg2), (void)(arg3))
+#endif
+
+//vlsm_entry(num_subnets, original prefix length)
+PROBE_SEMAPHORE(vlsm_entry);
+//vlsm_return(num_subnets, duration in ns)
+PROBE_SEMAPHORE(vlsm_return);
+//allocate(network address, prefix length)
+PROBE_SEMAPHORE(allocate);
+//release(network address, prefix length)
+PROBE_SEMAPHORE(release);
+//index_rebuild(num subnets, num intervals, duration in ns)
+PROBE_SEMAPHORE(index_rebuild);
+//acl_compile(num rules, num tuples, duration in ns)
+PROBE_SEMAPHORE(acl_compile);
 
 ip_address_t to_dotted_decimal_notation(uint32_t ip_address) {
     return (ip_address_t) {ip_address >> 24 & 0xFF, ip_address >> 16 & 0xFF, ip_address >> 8 & 0xFF, ip_address & 0xFF};
 }
 
 uint32_t to_int(ip_address_t ip_address) {
-    return (ip_address.byte1 << 24) + (ip_address.byte2 << 16) + (ip_address.byte3 << 8) + ip_address.byte4;
+    return ((uint32_t)ip_address.byte1 << 24) + (ip_address.byte2 << 16) + (ip_address.byte3 << 8) + ip_address.byte4;
 }
 
 void print_formatted_ip_address(uint32_t ip_address, const char* label) {
@@ -76,21 +414,24 @@ void print_subnet_params(subnet_t subnet_params) {
  * @return subnet_t 
  */
 subnet_t subnet_calculator(uint32_t ip_address, int cidr_prefix) {
+    INSTRUMENT_BEGIN(OP_SUBNET_CALCULATOR);
     //print_formatted_ip_address(ip_address, "ip address");
 
     subnet_t subnet_params;   
+    const prefix_params_t* prefix_params = &prefix_table[cidr_prefix];
 
     // calculate the network address by setting to 0 the host bits of the ip address
-    subnet_params.network_address = ip_address & (0xFFFFFFFF << (32 - cidr_prefix));
+    subnet_params.network_address = ip_address & prefix_params->subnet_mask;
     // calculate the broadcast address by setting to 1 the host bits of the ip address
-    subnet_params.broadcast_address = ip_address | (0xFFFFFFFF >> cidr_prefix);
+    subnet_params.broadcast_address = ip_address | prefix_params->host_mask;
     subnet_params.first_address = subnet_params.network_address + 1;    
     subnet_params.last_address = subnet_params.broadcast_address - 1;    
     subnet_params.next_network = subnet_params.broadcast_address + 1;    
     // calculate the subnet mask by setting to 1 the network bits of the network address
-    subnet_params.subnet_mask = subnet_params.network_address | (0xFFFFFFFF << (32 - cidr_prefix));    
+    subnet_params.subnet_mask = prefix_params->subnet_mask;
     subnet_params.num_ip_addresses = subnet_params.broadcast_address - subnet_params.network_address + 1; 
     subnet_params.prefixlen = cidr_prefix;   
+    INSTRUMENT_END(OP_SUBNET_CALCULATOR);
     return subnet_params;
 }
 
@@ -119,16 +460,18 @@ int calculate_subnet_size(int original_subnet_size, int num_subnets) {
  * 
  * @param original_subnet_size 
  * @param num_ip_addresses 
- * @return int maximum number of subnets
+ * @return uint64_t maximum number of subnets, up to 2^31 which does not fit in an int
  */
-int calculate_num_subnets(int original_subnet_size, int num_ip_addresses) {
+uint64_t calculate_num_subnets(int original_subnet_size, int num_ip_addresses) {
     //num bits required to represent num_ip_addresses
     int num_bits = log2(num_ip_addresses) + 1;
     //remaining bits to use for the new subnets
     int available_bits = 32 - num_bits - original_subnet_size;
-    //num subnets that can be created with the available bits
-    int num_subnets = exp2(available_bits);
-    return num_subnets;
+    if (available_bits < 0) {
+        return 0;
+    }
+    //num subnets that can be created with the available bits, i.e. the size of a subnet with that number of host bits
+    return prefix_table[32 - available_bits].num_ip_addresses;
 }
 
 /**
@@ -168,19 +511,22 @@ int compare_func(const void* a, const void* b) {
  * @return subnet_t* For convenience, the modified parameter 'subnets` is also returned
  */
 subnet_t* vlsm(subnet_t* original_subnet, subnet_t subnets[], size_t num_subnets) {
+    INSTRUMENT_BEGIN(OP_VLSM);
+    PROBE2(vlsm_entry, num_subnets, original_subnet->prefixlen);
+    uint64_t probe_start = PROBE_IS_ENABLED(vlsm_return) ? now_nanoseconds() : 0;
 
-    //sanity check
-    uint32_t total_num_ip_address_required = 0;
+    //calculate minimum subnet size    
     for (size_t i = 0; i < num_subnets; i++){
-        total_num_ip_address_required += calculate_subnet_prefixlen(subnets[i].num_ip_addresses);
+        subnets[i].prefixlen = calculate_subnet_prefixlen(subnets[i].num_ip_addresses);
     }
-    uint32_t total_num_ip_address_available = exp2(32 - original_subnet->prefixlen);
-    assert(total_num_ip_address_required < total_num_ip_address_available);
 
-    //calculate minimum subnet size    
+    //sanity check
+    uint64_t total_num_ip_address_required = 0;
     for (size_t i = 0; i < num_subnets; i++){
-        subnets[i].prefixlen = calculate_subnet_prefixlen(subnets[i].num_ip_addresses);
+        total_num_ip_address_required += prefix_table[subnets[i].prefixlen].num_ip_addresses;
     }
+    uint64_t total_num_ip_address_available = prefix_table[original_subnet->prefixlen].num_ip_addresses;
+    assert(total_num_ip_address_required <= total_num_ip_address_available);
 
     //sort subnets by size in descending order (ascending order by prefix length)
     qsort(subnets, num_subnets, sizeof(subnet_t), compare_func);
@@ -191,6 +537,8 @@ subnet_t* vlsm(subnet_t* original_subnet, subnet_t subnets[], size_t num_subnets
         subnets[i] = subnet_calculator(subnets[i-1].next_network, subnets[i].prefixlen);
     }
 
+    PROBE2(vlsm_return, num_subnets, probe_start != 0 ? now_nanoseconds() - probe_start : 0);
+    INSTRUMENT_END(OP_VLSM);
     return subnets;
 }
 
@@ -218,14 +566,5997 @@ void vlsm_test_cases() {
     }
 }
 
-int main(int argc, char const *argv[])
-{
+/**
+ * @brief Seconds elapsed since an arbitrary point in time, used to measure durations in benchmarks
+ */
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Pseudo-random number generator (splitmix64) used to generate reproducible synthetic data
+ */
+uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
+}
+
+int num_cpus() {
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return num_cpus > 0 ? num_cpus : 1;
+}
+
+/*
+ * Work-stealing scheduler
+ * 
+ * Each worker of a thread pool has a deque of jobs: its owner pushes and pops jobs at the bottom, while idle workers
+ * steal them from the top, so that the owner works depth-first on its most recent (smallest) jobs and thieves take the
+ * oldest (largest) ones. Jobs are spawned and joined in a strictly nested way, so they can live on the stack of the 
+ * function that spawns them, and a worker waiting for a job runs other jobs in the meantime.
+ * 
+ * The thread that calls a parallel primitive acts as worker 0 until it returns, the threads of the pool are the 
+ * workers 1 to num_workers - 1. A NULL pool runs everything on the calling thread. Workers that find no job yield for
+ * a while and then sleep until a job is spawned, so that an idle pool does not keep the cpus busy.
+ */
+#define WORK_DEQUE_CAPACITY 1024
+//failed attempts to find a job before an idle worker sleeps until a job is spawned
+#define THREAD_POOL_SPIN_LIMIT 64
+
+typedef struct {
+    void (*fn)(void* arg);
+    void* arg;
+    int done;
+} job_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t top;
+    size_t bottom;
+    job_t* jobs[WORK_DEQUE_CAPACITY];
+} __attribute__((aligned(64))) work_deque_t;
+
+typedef struct thread_pool thread_pool_t;
+
+typedef struct {
+    thread_pool_t* pool;
+    int id;
+} pool_worker_args_t;
+
+struct thread_pool {
+    int num_workers;
+    work_deque_t* deques;
+    pthread_t* threads;
+    pool_worker_args_t* worker_args;
+    pthread_mutex_t caller_lock;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int num_active_regions;
+    int num_sleeping;
+    int stopping;
+};
+
+_Thread_local thread_pool_t* current_pool = NULL;
+_Thread_local int current_worker = -1;
+_Thread_local uint64_t steal_seed = 0;
+
+void work_deque_push(work_deque_t* deque, job_t* job) {
+    pthread_mutex_lock(&deque->lock);
+    assert(deque->bottom - deque->top < WORK_DEQUE_CAPACITY);
+    deque->jobs[deque->bottom % WORK_DEQUE_CAPACITY] = job;
+    __atomic_store_n(&deque->bottom, deque->bottom + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&deque->lock);
+}
+
+job_t* work_deque_pop(work_deque_t* deque) {
+    job_t* job = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        __atomic_store_n(&deque->bottom, deque->bottom - 1, __ATOMIC_RELAXED);
+        job = deque->jobs[deque->bottom % WORK_DEQUE_CAPACITY];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return job;
+}
+
+job_t* work_deque_steal(work_deque_t* deque) {
+    //checked without the lock first, so that idle workers do not contend for the locks of empty deques
+    if (__atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) <= __atomic_load_n(&deque->top, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+    job_t* job = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        job = deque->jobs[deque->top % WORK_DEQUE_CAPACITY];
+        __atomic_store_n(&deque->top, deque->top + 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return job;
+}
+
+void run_job(job_t* job) {
+    job->fn(job->arg);
+    __atomic_store_n(&job->done, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Take a job of the current worker or, if it has none, steal one from a random worker
+ */
+job_t* thread_pool_find_job(thread_pool_t* pool) {
+    job_t* job = work_deque_pop(&pool->deques[current_worker]);
+    if (job != NULL) {
+        return job;
+    }
+    int first_victim = splitmix64(&steal_seed) % pool->num_workers;
+    for (int i = 0; i < pool->num_workers && job == NULL; i++){
+        int victim = (first_victim + i) % pool->num_workers;
+        if (victim != current_worker) {
+            job = work_deque_steal(&pool->deques[victim]);
+        }
+    }
+    return job;
+}
+
+int thread_pool_has_jobs(thread_pool_t* pool) {
+    for (int i = 0; i < pool->num_workers; i++){
+        work_deque_t* deque = &pool->deques[i];
+        if (__atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) > __atomic_load_n(&deque->top, __ATOMIC_RELAXED)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Sleep until a job is spawned, the region ends or the pool stops
+ * 
+ * The sleeper is counted before checking the deques and the spawner pushes before reading the count, both with
+ * read-modify-writes of the count, so either the sleeper sees the job or the spawner sees the sleeper and wakes it up.
+ */
+void thread_pool_sleep(thread_pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    __atomic_fetch_add(&pool->num_sleeping, 1, __ATOMIC_ACQ_REL);
+    if (!pool->stopping && pool->num_active_regions > 0 && !thread_pool_has_jobs(pool)) {
+        pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    __atomic_fetch_sub(&pool->num_sleeping, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void* thread_pool_worker(void* arg) {
+    pool_worker_args_t* args = arg;
+    thread_pool_t* pool = args->pool;
+    current_pool = pool;
+    current_worker = args->id;
+    steal_seed = args->id;
+    int num_failures = 0;
+    for (;;) {
+        if (__atomic_load_n(&pool->num_active_regions, __ATOMIC_ACQUIRE) == 0) {
+            pthread_mutex_lock(&pool->lock);
+            while (!pool->stopping && pool->num_active_regions == 0) {
+                pthread_cond_wait(&pool->wake, &pool->lock);
+            }
+            int stopping = pool->stopping;
+            pthread_mutex_unlock(&pool->lock);
+            if (stopping) {
+                break;
+            }
+        }
+        job_t* job = thread_pool_find_job(pool);
+        if (job != NULL) {
+            run_job(job);
+            num_failures = 0;
+        } else if (++num_failures < THREAD_POOL_SPIN_LIMIT) {
+            sched_yield();
+        } else {
+            thread_pool_sleep(pool);
+            num_failures = 0;
+        }
+    }
+    return NULL;
+}
+
+thread_pool_t* thread_pool_create(int num_workers) {
+    assert(num_workers >= 1);
+    thread_pool_t* pool = calloc(1, sizeof(thread_pool_t));
+    pool->num_workers = num_workers;
+    pool->deques = aligned_alloc(64, num_workers * sizeof(work_deque_t));
+    pool->threads = malloc(num_workers * sizeof(pthread_t));
+    pool->worker_args = malloc(num_workers * sizeof(pool_worker_args_t));
+    pthread_mutex_init(&pool->caller_lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    for (int i = 0; i < num_workers; i++){
+        pool->deques[i].top = pool->deques[i].bottom = 0;
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+    }
+    for (int i = 1; i < num_workers; i++){
+        pool->worker_args[i] = (pool_worker_args_t) {pool, i};
+        pthread_create(&pool->threads[i], NULL, thread_pool_worker, &pool->worker_args[i]);
+    }
+    return pool;
+}
+
+void thread_pool_destroy(thread_pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; i < pool->num_workers; i++){
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (int i = 0; i < pool->num_workers; i++){
+        pthread_mutex_destroy(&pool->deques[i].lock);
+    }
+    pthread_mutex_destroy(&pool->caller_lock);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    free(pool->worker_args);
+    free(pool->threads);
+    free(pool->deques);
+    free(pool);
+}
+
+int thread_pool_num_workers(const thread_pool_t* pool) {
+    return pool == NULL ? 1 : pool->num_workers;
+}
+
+thread_pool_t* default_pool = NULL;
+pthread_once_t default_pool_once = PTHREAD_ONCE_INIT;
+
+void create_default_thread_pool() {
+    default_pool = thread_pool_create(num_cpus());
+}
+
+/**
+ * @brief Pool with one worker per cpu, created on first use and shared by the whole program
+ */
+thread_pool_t* default_thread_pool() {
+    pthread_once(&default_pool_once, create_default_thread_pool);
+    return default_pool;
+}
+
+/**
+ * @brief Whether parallel primitives called by the current thread run on the workers of 'pool'
+ * 
+ * A worker of another pool runs them sequentially: it cannot leave its own pool, whose jobs may be waiting for it.
+ */
+int thread_pool_usable(const thread_pool_t* pool) {
+    return pool != NULL && pool->num_workers > 1 && (current_pool == NULL || current_pool == pool);
+}
+
+/**
+ * @brief Make the calling thread the worker 0 of the pool, unless it is already one of its workers (nested call)
+ * 
+ * @return int whether 'thread_pool_leave' has to release the pool
+ */
+int thread_pool_enter(thread_pool_t* pool) {
+    if (current_pool == pool) {
+        return 0;
+    }
+    //only one thread outside the pool can use it at a time
+    pthread_mutex_lock(&pool->caller_lock);
+    current_pool = pool;
+    current_worker = 0;
+    pthread_mutex_lock(&pool->lock);
+    __atomic_store_n(&pool->num_active_regions, pool->num_active_regions + 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    return 1;
+}
+
+void thread_pool_leave(thread_pool_t* pool, int entered) {
+    if (!entered) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    __atomic_store_n(&pool->num_active_regions, pool->num_active_regions - 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&pool->lock);
+    current_pool = NULL;
+    current_worker = -1;
+    pthread_mutex_unlock(&pool->caller_lock);
+}
+
+/**
+ * @brief Make a job available to the other workers, it must be joined before the function that spawns it returns
+ */
+void thread_pool_spawn(thread_pool_t* pool, job_t* job) {
+    job->done = 0;
+    work_deque_push(&pool->deques[current_worker], job);
+    if (__atomic_fetch_add(&pool->num_sleeping, 0, __ATOMIC_ACQ_REL) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_signal(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/**
+ * @brief Wait for a spawned job, running it if no worker has stolen it, or running other jobs while it is not finished
+ */
+void thread_pool_join(thread_pool_t* pool, job_t* job) {
+    while (!__atomic_load_n(&job->done, __ATOMIC_ACQUIRE)) {
+        job_t* other = thread_pool_find_job(pool);
+        if (other != NULL) {
+            run_job(other);
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * @brief Number of workers of the next point of a scaling curve: powers of 2 up to the number of cpus, and the number of cpus
+ */
+int next_num_workers(int num_workers) {
+    return num_workers < num_cpus() && 2 * num_workers > num_cpus() ? num_cpus() : 2 * num_workers;
+}
+
+/**
+ * @brief Default grain: about 8 ranges per worker, so that the load can be balanced
+ */
+size_t parallel_grain(const thread_pool_t* pool, size_t count, size_t grain) {
+    if (grain > 0) {
+        return grain;
+    }
+    grain = count / (8 * thread_pool_num_workers(pool));
+    return grain > 0 ? grain : 1;
+}
+
+typedef struct {
+    thread_pool_t* pool;
+    void (*fn)(void* context, size_t begin, size_t end);
+    void* context;
+    size_t begin;
+    size_t end;
+    size_t grain;
+} parallel_for_args_t;
+
+void parallel_for_job(void* arg) {
+    parallel_for_args_t* args = arg;
+    if (args->end - args->begin <= args->grain) {
+        args->fn(args->context, args->begin, args->end);
+        return;
+    }
+    size_t middle = args->begin + (args->end - args->begin) / 2;
+    parallel_for_args_t left = *args, right = *args;
+    left.end = middle;
+    right.begin = middle;
+    job_t job = {.fn = parallel_for_job, .arg = &right};
+    thread_pool_spawn(args->pool, &job);
+    parallel_for_job(&left);
+    thread_pool_join(args->pool, &job);
+}
+
+/**
+ * @brief Call 'fn' on disjoint ranges that cover [begin, end), in parallel
+ * 
+ * @param grain largest range passed to 'fn', 0 to choose it according to the number of workers
+ */
+void parallel_for(thread_pool_t* pool, size_t begin, size_t end, size_t grain, void (*fn)(void* context, size_t begin, size_t end), void* context) {
+    if (begin >= end) {
+        return;
+    }
+    grain = parallel_grain(pool, end - begin, grain);
+    if (!thread_pool_usable(pool) || end - begin <= grain) {
+        fn(context, begin, end);
+        return;
+    }
+    int entered = thread_pool_enter(pool);
+    parallel_for_args_t args = {pool, fn, context, begin, end, grain};
+    parallel_for_job(&args);
+    thread_pool_leave(pool, entered);
+}
+
+typedef struct {
+    thread_pool_t* pool;
+    void (*reduce)(void* context, size_t begin, size_t end, void* result);
+    void (*combine)(void* context, void* result, const void* other);
+    void* context;
+    const void* identity;
+    size_t result_size;
+    size_t begin;
+    size_t end;
+    size_t grain;
+    void* result;
+} parallel_reduce_args_t;
+
+void parallel_reduce_job(void* arg) {
+    parallel_reduce_args_t* args = arg;
+    if (args->end - args->begin <= args->grain) {
+        args->reduce(args->context, args->begin, args->end, args->result);
+        return;
+    }
+    size_t middle = args->begin + (args->end - args->begin) / 2;
+    //results are accessed as their own type by 'reduce' and 'combine', so the buffer needs the strictest alignment
+    _Alignas(max_align_t) char right_result[args->result_size];
+    memcpy(right_result, args->identity, args->result_size);
+    parallel_reduce_args_t left = *args, right = *args;
+    left.end = middle;
+    right.begin = middle;
+    right.result = right_result;
+    job_t job = {.fn = parallel_reduce_job, .arg = &right};
+    thread_pool_spawn(args->pool, &job);
+    parallel_reduce_job(&left);
+    thread_pool_join(args->pool, &job);
+    args->combine(args->context, args->result, right_result);
+}
+
+/**
+ * @brief Reduce the range [begin, end) in parallel
+ * 
+ * 'result' is initialized with 'identity', each range is accumulated by 'reduce' into a partial result and partial 
+ * results are combined in order with 'combine', which must be associative.
+ */
+void parallel_reduce(thread_pool_t* pool, size_t begin, size_t end, size_t grain, const void* identity, size_t result_size,
+    void (*reduce)(void* context, size_t begin, size_t end, void* result), void (*combine)(void* context, void* result, const void* other),
+    void* context, void* result) {
+    memcpy(result, identity, result_size);
+    if (begin >= end) {
+        return;
+    }
+    grain = parallel_grain(pool, end - begin, grain);
+    if (!thread_pool_usable(pool) || end - begin <= grain) {
+        reduce(context, begin, end, result);
+        return;
+    }
+    int entered = thread_pool_enter(pool);
+    parallel_reduce_args_t args = {pool, reduce, combine, context, identity, result_size, begin, end, grain, result};
+    parallel_reduce_job(&args);
+    thread_pool_leave(pool, entered);
+}
+
+typedef struct {
+    thread_pool_t* pool;
+    const char* a;
+    size_t num_a;
+    const char* b;
+    size_t num_b;
+    char* out;
+    size_t size;
+    int (*compar)(const void*, const void*);
+    size_t grain;
+} parallel_merge_args_t;
+
+void parallel_merge_job(void* arg) {
+    parallel_merge_args_t* args = arg;
+    size_t size = args->size;
+    if (args->num_a + args->num_b <= args->grain || args->num_a <= 1 || args->num_b <= 1) {
+        const char *a = args->a, *a_end = a + args->num_a * size, *b = args->b, *b_end = b + args->num_b * size;
+        char* out = args->out;
+        while (a < a_end && b < b_end) {
+            //equal elements are taken from 'a' first, which keeps the merge stable
+            if (args->compar(b, a) < 0) {
+                memcpy(out, b, size);
+                b += size;
+            } else {
+                memcpy(out, a, size);
+                a += size;
+            }
+            out += size;
+        }
+        memcpy(out, a, a_end - a);
+        memcpy(out + (a_end - a), b, b_end - b);
+        return;
+    }
+    //split the larger sequence in half and the other one at the same element, both halves are merged in parallel
+    parallel_merge_args_t left = *args, right = *args;
+    if (args->num_a >= args->num_b) {
+        size_t middle_a = args->num_a / 2, low = 0, high = args->num_b;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (args->compar(args->b + middle * size, args->a + middle_a * size) < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        left.num_a = middle_a;
+        left.num_b = low;
+    } else {
+        size_t middle_b = args->num_b / 2, low = 0, high = args->num_a;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (args->compar(args->b + middle_b * size, args->a + middle * size) < 0) {
+                high = middle;
+            } else {
+                low = middle + 1;
+            }
+        }
+        left.num_a = low;
+        left.num_b = middle_b;
+    }
+    right.a = args->a + left.num_a * size;
+    right.num_a = args->num_a - left.num_a;
+    right.b = args->b + left.num_b * size;
+    right.num_b = args->num_b - left.num_b;
+    right.out = args->out + (left.num_a + left.num_b) * size;
+    job_t job = {.fn = parallel_merge_job, .arg = &right};
+    thread_pool_spawn(args->pool, &job);
+    parallel_merge_job(&left);
+    thread_pool_join(args->pool, &job);
+}
+
+#define INSERTION_SORT_THRESHOLD 16
+
+/**
+ * @brief Stable merge sort of 'base' on the calling thread, 'buffer' must have room for 'num_elements' elements
+ * 
+ * Short ranges are sorted by insertion, and the merge is skipped when both halves are already in order, which makes
+ * sorted inputs such as routing tables cost a single comparison per range.
+ */
+void stable_sort(char* base, char* buffer, size_t num_elements, size_t size, int (*compar)(const void*, const void*)) {
+    if (num_elements <= INSERTION_SORT_THRESHOLD) {
+        for (size_t i = 1; i < num_elements; i++){
+            size_t j = i;
+            while (j > 0 && compar(base + (j - 1) * size, base + i * size) > 0) {
+                j--;
+            }
+            if (j < i) {
+                memcpy(buffer, base + i * size, size);
+                memmove(base + (j + 1) * size, base + j * size, (i - j) * size);
+                memcpy(base + j * size, buffer, size);
+            }
+        }
+        return;
+    }
+    size_t middle = num_elements / 2;
+    stable_sort(base, buffer, middle, size, compar);
+    stable_sort(base + middle * size, buffer + middle * size, num_elements - middle, size, compar);
+    if (compar(base + (middle - 1) * size, base + middle * size) <= 0) {
+        return;
+    }
+    memcpy(buffer, base, num_elements * size);
+    const char *a = buffer, *a_end = buffer + middle * size, *b = a_end, *b_end = buffer + num_elements * size;
+    char* out = base;
+    while (a < a_end && b < b_end) {
+        if (compar(b, a) < 0) {
+            memcpy(out, b, size);
+            b += size;
+        } else {
+            memcpy(out, a, size);
+            a += size;
+        }
+        out += size;
+    }
+    memcpy(out, a, a_end - a);
+    memcpy(out + (a_end - a), b, b_end - b);
+}
+
+typedef struct {
+    thread_pool_t* pool;
+    char* base;
+    char* buffer;
+    size_t num_elements;
+    size_t size;
+    int (*compar)(const void*, const void*);
+    size_t grain;
+    int to_buffer;
+} parallel_sort_args_t;
+
+/**
+ * @brief Sort 'base', leaving the result in 'base' or in 'buffer' depending on 'to_buffer'
+ */
+void parallel_sort_job(void* arg) {
+    parallel_sort_args_t* args = arg;
+    if (args->num_elements <= args->grain) {
+        stable_sort(args->base, args->buffer, args->num_elements, args->size, args->compar);
+        if (args->to_buffer) {
+            memcpy(args->buffer, args->base, args->num_elements * args->size);
+        }
+        return;
+    }
+    //both halves are sorted into the other array and then merged into the one of the result
+    size_t middle = args->num_elements / 2;
+    parallel_sort_args_t left = *args, right = *args;
+    left.num_elements = middle;
+    left.to_buffer = !args->to_buffer;
+    right.base = args->base + middle * args->size;
+    right.buffer = args->buffer + middle * args->size;
+    right.num_elements = args->num_elements - middle;
+    right.to_buffer = !args->to_buffer;
+    job_t job = {.fn = parallel_sort_job, .arg = &right};
+    thread_pool_spawn(args->pool, &job);
+    parallel_sort_job(&left);
+    thread_pool_join(args->pool, &job);
+
+    char* from = args->to_buffer ? args->base : args->buffer;
+    parallel_merge_args_t merge = {args->pool, from, middle, from + middle * args->size, args->num_elements - middle,
+        args->to_buffer ? args->buffer : args->base, args->size, args->compar, args->grain};
+    parallel_merge_job(&merge);
+}
+
+/**
+ * @brief Stable merge sort in parallel, ranges of up to 'grain' elements are sorted by 'stable_sort'
+ */
+void parallel_sort(thread_pool_t* pool, void* base, size_t num_elements, size_t size, size_t grain, int (*compar)(const void*, const void*)) {
+    if (num_elements <= 1) {
+        return;
+    }
+    grain = parallel_grain(pool, num_elements, grain);
+    char* buffer = malloc(num_elements * size);
+    if (!thread_pool_usable(pool) || num_elements <= grain) {
+        stable_sort(base, buffer, num_elements, size, compar);
+        free(buffer);
+        return;
+    }
+    int entered = thread_pool_enter(pool);
+    parallel_sort_args_t args = {pool, base, buffer, num_elements, size, compar, grain, 0};
+    parallel_sort_job(&args);
+    thread_pool_leave(pool, entered);
+    free(buffer);
+}
+
+/**
+ * @brief data structure to represent a node of a hierarchical allocation plan
+ * 
+ * e.g. region -> zone -> VPC -> subnet
+ * 
+ * Leaf nodes specify the minimum number of hosts of the subnet with the attribute 'num_hosts'. Inner nodes are sized
+ * to contain all their children.
+ * Once the plan is calculated, the attribute 'subnet' contains the parameters of the subnet allocated to the node
+ */
+typedef struct plan_node_t {
+    subnet_t subnet;
+    int num_hosts;
+    struct plan_node_t* children;
+    size_t num_children;
+} plan_node_t;
+
+int compare_plan_nodes(const void* a, const void* b) {
+    return ((plan_node_t*)a)->subnet.prefixlen - ((plan_node_t*)b)->subnet.prefixlen;
+}
+
+/**
+ * @brief Calculate the prefix length of a node whose children have already been sized
+ * 
+ * @return int 0 if successful, -1 if the children need more addresses than the whole address space
+ */
+int fit_plan_node(plan_node_t* node) {
+    if (node->num_children == 0) {
+        node->subnet.prefixlen = calculate_subnet_prefixlen(node->num_hosts);
+        return 0;
+    }
+    uint64_t num_ip_addresses_required = 0;
+    for (size_t i = 0; i < node->num_children; i++){
+        num_ip_addresses_required += prefix_table[node->children[i].subnet.prefixlen].num_ip_addresses;
+    }
+    //the children are blocks whose size is a power of 2, once sorted by size in descending order they are
+    //packed without gaps, so the node needs the smallest block that can contain the sum of their sizes
+    int prefixlen = 32;
+    while (prefixlen > 0 && prefix_table[prefixlen].num_ip_addresses < num_ip_addresses_required) {
+        prefixlen--;
+    }
+    if (prefix_table[prefixlen].num_ip_addresses < num_ip_addresses_required) {
+        return -1;
+    }
+    node->subnet.prefixlen = prefixlen;
+    return 0;
+}
+
+/**
+ * @brief Calculate bottom-up the prefix length of every node of the subtree
+ * 
+ * @return int 0 if successful, -1 if a node does not fit in the address space
+ */
+int size_plan_node(plan_node_t* node) {
+    for (size_t i = 0; i < node->num_children; i++){
+        if (size_plan_node(&node->children[i]) < 0) {
+            return -1;
+        }
+    }
+    return fit_plan_node(node);
+}
+
+/**
+ * @brief Allocate the children of a node, whose subnet is already known, in descending order of size
+ */
+void place_plan_node_children(plan_node_t* node) {
+    //leaves have no array of children to sort
+    if (node->num_children == 0) {
+        return;
+    }
+    qsort(node->children, node->num_children, sizeof(plan_node_t), compare_plan_nodes);
+    uint32_t next_network = node->subnet.network_address;
+    for (size_t i = 0; i < node->num_children; i++){
+        node->children[i].subnet = subnet_calculator(next_network, node->children[i].subnet.prefixlen);
+        next_network = node->children[i].subnet.next_network;
+    }
+}
+
+/**
+ * @brief Allocate top-down every node of the subtree
+ */
+int allocate_plan_node(plan_node_t* node) {
+    place_plan_node_children(node);
+    for (size_t i = 0; i < node->num_children; i++){
+        allocate_plan_node(&node->children[i]);
+    }
+    return 0;
+}
+
+//subtrees with fewer nodes are calculated by the job of their parent, larger ones spawn a job per child
+#define PLAN_SUBTREE_GRAIN 256
+
+/**
+ * @brief Number of nodes of the subtree, the count stops at 'limit'
+ */
+size_t count_plan_nodes(const plan_node_t* node, size_t limit) {
+    size_t count = 1;
+    for (size_t i = 0; i < node->num_children && count < limit; i++){
+        count += count_plan_nodes(&node->children[i], limit - count);
+    }
+    return count;
+}
+
+typedef struct {
+    thread_pool_t* pool;
+    plan_node_t* nodes;
+    int (*fn)(plan_node_t*, thread_pool_t*);
+    int error;
+} plan_worker_args_t;
+
+void plan_worker(void* context, size_t begin, size_t end) {
+    plan_worker_args_t* args = context;
+    for (size_t i = begin; i < end; i++){
+        if (args->fn(&args->nodes[i], args->pool) < 0) {
+            __atomic_store_n(&args->error, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * @brief Apply 'fn' to each of the independent subtrees rooted at 'nodes', in parallel on the workers of 'pool'
+ * 
+ * Subtrees can be very different in size, so ranges of them are separate jobs that idle workers can steal, and large
+ * subtrees spawn jobs of their own
+ * 
+ * @return int 0 if successful, -1 if 'fn' failed on any subtree
+ */
+int for_each_plan_subtree(plan_node_t nodes[], size_t num_nodes, int (*fn)(plan_node_t*, thread_pool_t*), thread_pool_t* pool) {
+    plan_worker_args_t args = {pool, nodes, fn, 0};
+    parallel_for(pool, 0, num_nodes, 0, plan_worker, &args);
+    return args.error ? -1 : 0;
+}
+
+/**
+ * @brief Size the subtree bottom-up, the children of large subtrees in parallel at every level
+ */
+int size_plan_subtree(plan_node_t* node, thread_pool_t* pool) {
+    if (count_plan_nodes(node, PLAN_SUBTREE_GRAIN) < PLAN_SUBTREE_GRAIN) {
+        return size_plan_node(node);
+    }
+    if (for_each_plan_subtree(node->children, node->num_children, size_plan_subtree, pool) < 0) {
+        return -1;
+    }
+    return fit_plan_node(node);
+}
+
+/**
+ * @brief Allocate the subtree top-down, the children of large subtrees in parallel at every level
+ */
+int allocate_plan_subtree(plan_node_t* node, thread_pool_t* pool) {
+    if (count_plan_nodes(node, PLAN_SUBTREE_GRAIN) < PLAN_SUBTREE_GRAIN) {
+        return allocate_plan_node(node);
+    }
+    place_plan_node_children(node);
+    return for_each_plan_subtree(node->children, node->num_children, allocate_plan_subtree, pool);
+}
+
+/**
+ * @brief Calculate a hierarchical allocation plan
+ * 
+ * The root of the tree specifies the network to split with the attributes 'subnet.network_address' and 'subnet.prefixlen'.
+ * Every level is sized bottom-up and then allocated top-down, that is, the subnet of each node is split into the
+ * subnets of its children in the same way as 'vlsm' does. Independent subtrees are calculated in parallel, recursively
+ * down to subtrees of PLAN_SUBTREE_GRAIN nodes.
+ * 
+ * The children of each node are sorted according to the size of the subnet in descending order.
+ * 
+ * @param root in-out parameter
+ * @param pool thread pool, NULL to calculate the plan on the calling thread
+ * @return plan_node_t* For convenience, the modified parameter 'root' is also returned, NULL if the tree does not fit
+ * in the subnet of the root
+ */
+plan_node_t* plan_hierarchy(plan_node_t* root, thread_pool_t* pool) {
+    subnet_t original_subnet = root->subnet;
+
+    if (size_plan_subtree(root, pool) < 0 || root->subnet.prefixlen < original_subnet.prefixlen) {
+        root->subnet = original_subnet;
+        return NULL;
+    }
+
+    root->subnet = subnet_calculator(original_subnet.network_address, original_subnet.prefixlen);
+    allocate_plan_subtree(root, pool);
+    return root;
+}
+
+#define ARENA_BLOCK_SIZE (2 << 20)
+#define ARENA_HEADER_SIZE 64
+
+/**
+ * @brief block of memory of an arena, the memory handed out starts ARENA_HEADER_SIZE bytes after the header
+ */
+typedef struct arena_block_t {
+    struct arena_block_t* next;
+    size_t capacity;
+    size_t used;
+} arena_block_t;
+
+/**
+ * @brief data structure to allocate the many small objects of a job (plan nodes, trie nodes...) from large blocks
+ * 
+ * Allocating is a pointer bump, objects are not freed individually: the arena is reset in bulk between jobs, keeping
+ * its blocks to be reused by the next job, and destroyed at the end.
+ * Blocks are mapped in multiples of 2MB, backed by huge pages when requested and the system has them available.
+ */
+typedef struct {
+    arena_block_t* first;
+    arena_block_t* current;
+    int use_hugepages;
+} arena_t;
+
+arena_t arena_init(int use_hugepages) {
+    return (arena_t) {NULL, NULL, use_hugepages};
+}
+
+arena_block_t* arena_map_block(size_t size, int use_hugepages) {
+    size = (size + ARENA_BLOCK_SIZE - 1) & ~(size_t)(ARENA_BLOCK_SIZE - 1);
+    void* memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (use_hugepages) {
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (memory == MAP_FAILED) {
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        //no huge pages reserved: fall back on transparent huge pages
+        if (use_hugepages) {
+            madvise(memory, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    arena_block_t* block = memory;
+    *block = (arena_block_t) {NULL, size - ARENA_HEADER_SIZE, 0};
+    return block;
+}
+
+/**
+ * @brief Allocate 'size' bytes aligned to 16 bytes
+ * 
+ * @return void* the memory allocated, NULL if out of memory
+ */
+void* arena_alloc(arena_t* arena, size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    while (arena->current == NULL || arena->current->used + size > arena->current->capacity) {
+        arena_block_t* next = arena->current != NULL ? arena->current->next : arena->first;
+        if (next == NULL) {
+            next = arena_map_block(size + ARENA_HEADER_SIZE, arena->use_hugepages);
+            if (next == NULL) {
+                return NULL;
+            }
+            if (arena->current != NULL) {
+                next->next = arena->current->next;
+                arena->current->next = next;
+            } else {
+                arena->first = next;
+            }
+        }
+        next->used = 0;
+        arena->current = next;
+    }
+    void* memory = (char*)arena->current + ARENA_HEADER_SIZE + arena->current->used;
+    arena->current->used += size;
+    return memory;
+}
+
+void* arena_calloc(arena_t* arena, size_t num_elements, size_t element_size) {
+    void* memory = arena_alloc(arena, num_elements * element_size);
+    if (memory != NULL) {
+        memset(memory, 0, num_elements * element_size);
+    }
+    return memory;
+}
+
+/**
+ * @brief Release in bulk all the memory allocated, the blocks are kept to be reused
+ */
+void arena_reset(arena_t* arena) {
+    arena->current = NULL;
+}
+
+void arena_destroy(arena_t* arena) {
+    arena_block_t* block = arena->first;
+    while (block != NULL) {
+        arena_block_t* next = block->next;
+        munmap(block, block->capacity + ARENA_HEADER_SIZE);
+        block = next;
+    }
+    *arena = arena_init(arena->use_hugepages);
+}
+
+/**
+ * @brief Cost of allocating 10M plan nodes one by one with malloc compared with an arena, over several jobs
+ */
+void arena_benchmark() {
+    size_t num_nodes = 10000000;
+    int num_jobs = 3;
+    plan_node_t** nodes = malloc(num_nodes * sizeof(plan_node_t*));
+    arena_t arena = arena_init(1);
+
+    double start = now_seconds();
+    for (int job = 0; job < num_jobs; job++){
+        for (size_t i = 0; i < num_nodes; i++){
+            nodes[i] = malloc(sizeof(plan_node_t));
+            nodes[i]->num_hosts = i;
+        }
+        for (size_t i = 0; i < num_nodes; i++){
+            free(nodes[i]);
+        }
+    }
+    double malloc_time = now_seconds() - start;
+
+    start = now_seconds();
+    for (int job = 0; job < num_jobs; job++){
+        for (size_t i = 0; i < num_nodes; i++){
+            nodes[i] = arena_alloc(&arena, sizeof(plan_node_t));
+            nodes[i]->num_hosts = i;
+        }
+        arena_reset(&arena);
+    }
+    double arena_time = now_seconds() - start;
+
+    printf("%d jobs of %zu nodes: malloc/free %.1f ns/node, arena %.1f ns/node\n", num_jobs, num_nodes,
+        malloc_time / num_jobs / num_nodes * 1e9, arena_time / num_jobs / num_nodes * 1e9);
+
+    arena_destroy(&arena);
+    free(nodes);
+}
+
+/**
+ * @brief Plan a synthetic tree with 100K leaves: 10.0.0.0/8 split into 4 regions x 5 zones x 50 VPCs x 100 subnets
+ */
+void plan_hierarchy_benchmark() {
+    size_t num_regions = 4, num_zones = 5, num_vpcs = 50, num_subnets = 100;
+    plan_node_t root = {.subnet = {.network_address = 167772160, .prefixlen = 8}};
+    arena_t arena = arena_init(1);
+    plan_node_t* regions = arena_calloc(&arena, num_regions, sizeof(plan_node_t));
+    plan_node_t* zones = arena_calloc(&arena, num_regions * num_zones, sizeof(plan_node_t));
+    plan_node_t* vpcs = arena_calloc(&arena, num_regions * num_zones * num_vpcs, sizeof(plan_node_t));
+    plan_node_t* subnets = arena_calloc(&arena, num_regions * num_zones * num_vpcs * num_subnets, sizeof(plan_node_t));
+    uint64_t seed = 26;
+
+    root = (plan_node_t) {.subnet = root.subnet, .children = regions, .num_children = num_regions};
+    for (size_t i = 0; i < num_regions; i++){
+        regions[i] = (plan_node_t) {.children = &zones[i * num_zones], .num_children = num_zones};
+    }
+    for (size_t i = 0; i < num_regions * num_zones; i++){
+        zones[i] = (plan_node_t) {.children = &vpcs[i * num_vpcs], .num_children = num_vpcs};
+    }
+    for (size_t i = 0; i < num_regions * num_zones * num_vpcs; i++){
+        vpcs[i] = (plan_node_t) {.children = &subnets[i * num_subnets], .num_children = num_subnets};
+    }
+    for (size_t i = 0; i < num_regions * num_zones * num_vpcs * num_subnets; i++){
+        subnets[i].num_hosts = 2 + splitmix64(&seed) % 29;
+    }
+
+    thread_pool_t* pool = default_thread_pool();
+    int num_threads = thread_pool_num_workers(pool);
+    double start = now_seconds();
+    plan_node_t* result = plan_hierarchy(&root, pool);
+    double elapsed = now_seconds() - start;
+    assert(result != NULL);
+    (void)result;
+    printf("planned %zu leaves in %.3f ms using %d threads\n", num_regions * num_zones * num_vpcs * num_subnets, elapsed * 1e3, num_threads);
+    for (size_t i = 0; i < num_regions; i++){
+        printf("\n");
+        print_subnet_params(regions[i].subnet);
+    }
+
+    arena_destroy(&arena);
+}
+
+#define NO_FREE_BLOCK 33
+
+/**
+ * @brief data structure to keep track of the free space of a pool of ip addresses
+ * 
+ * The pool is represented as a complete binary tree (buddy tree) whose root is the pool and whose leaves are the blocks
+ * of size /granularity. Node 'i' has children '2i' and '2i+1', the root being the node 1.
+ * 
+ * For each node the tree stores:
+ * - largest_free: prefix length of the largest free block inside the node, NO_FREE_BLOCK if there is none
+ * - allocated: whether the block represented by the node has been allocated as a whole
+ * 
+ * Additionally, the number of free blocks of each size is kept up to date, so that all queries are O(log n)
+ */
+typedef struct {
+    subnet_t pool;
+    int granularity;
+    uint8_t* largest_free;
+    uint8_t* allocated;
+    uint64_t free_blocks[33];
+} free_space_index_t;
+
+/**
+ * @brief Create the index of a pool whose addresses are all free
+ * 
+ * @param pool 
+ * @param granularity prefix length of the smallest block that can be allocated
+ * @return free_space_index_t 
+ */
+free_space_index_t free_space_index_init(subnet_t pool, int granularity) {
+    assert(pool.prefixlen <= granularity && granularity <= 32);
+    free_space_index_t index = {.pool = subnet_calculator(pool.network_address, pool.prefixlen), .granularity = granularity};
+    size_t num_nodes = (size_t)2 << (granularity - pool.prefixlen);
+    index.largest_free = malloc(num_nodes);
+    index.allocated = calloc(num_nodes, 1);
+    for (int level = pool.prefixlen; level <= granularity; level++){
+        size_t first_node = (size_t)1 << (level - pool.prefixlen);
+        memset(&index.largest_free[first_node], level, first_node);
+        index.free_blocks[level] = first_node;
+    }
+    return index;
+}
+
+void free_space_index_destroy(free_space_index_t* index) {
+    free(index->largest_free);
+    free(index->allocated);
+}
+
+/**
+ * @brief Bytes used by the index, 2 bytes per node of the tree
+ */
+size_t free_space_index_memory(const free_space_index_t* index) {
+    return sizeof(free_space_index_t) + 2 * ((size_t)2 << (index->granularity - index->pool.prefixlen));
+}
+
+/**
+ * @brief Find the node representing the block 'subnet'
+ * 
+ * @return size_t the node, or 0 if the block is not in the pool, has host bits set or is inside a block already allocated
+ */
+size_t free_space_find_node(const free_space_index_t* index, const subnet_t* subnet) {
+    int pool_prefixlen = index->pool.prefixlen;
+    assert(pool_prefixlen <= subnet->prefixlen && subnet->prefixlen <= index->granularity);
+    if ((subnet->network_address & index->pool.subnet_mask) != index->pool.network_address) {
+        return 0;
+    }
+    if ((subnet->network_address & prefix_table[subnet->prefixlen].host_mask) != 0) {
+        return 0;
+    }
+    size_t node = 1;
+    for (int level = pool_prefixlen; level < subnet->prefixlen; level++){
+        if (index->allocated[node]) {
+            return 0;
+        }
+        node = 2 * node + (subnet->network_address >> (31 - level) & 1);
+    }
+    return node;
+}
+
+/**
+ * @brief Recalculate the largest free block of the ancestors of 'node' and the number of free blocks of their size
+ */
+void free_space_update_ancestors(free_space_index_t* index, size_t node, int level) {
+    for (node /= 2, level--; node > 0; node /= 2, level--){
+        int was_free = index->largest_free[node] == level;
+        uint8_t left = index->largest_free[2 * node];
+        uint8_t right = index->largest_free[2 * node + 1];
+        if (index->allocated[node]) {
+            index->largest_free[node] = NO_FREE_BLOCK;
+        } else if (left == level + 1 && right == level + 1) {
+            index->largest_free[node] = level;
+        } else {
+            index->largest_free[node] = left < right ? left : right;
+        }
+        int is_free = index->largest_free[node] == level;
+        index->free_blocks[level] += is_free - was_free;
+    }
+}
+
+/**
+ * @brief Mark the block 'subnet' as allocated
+ * 
+ * @return int 0 if successful, -1 if the block is not in the pool or any of its addresses is already allocated
+ */
+int free_space_allocate(free_space_index_t* index, const subnet_t* subnet) {
+    INSTRUMENT_BEGIN(OP_FREE_SPACE_ALLOCATE);
+    int result = -1;
+    size_t node = free_space_find_node(index, subnet);
+    if (node != 0 && index->largest_free[node] == subnet->prefixlen) {
+        index->allocated[node] = 1;
+        index->largest_free[node] = NO_FREE_BLOCK;
+        for (int level = subnet->prefixlen; level <= index->granularity; level++){
+            index->free_blocks[level] -= (uint64_t)1 << (level - subnet->prefixlen);
+        }
+        free_space_update_ancestors(index, node, subnet->prefixlen);
+        PROBE2(allocate, subnet->network_address, subnet->prefixlen);
+        result = 0;
+    }
+    INSTRUMENT_END(OP_FREE_SPACE_ALLOCATE);
+    return result;
+}
+
+/**
+ * @brief Mark the block 'subnet', previously allocated, as free
+ * 
+ * @return int 0 if successful, -1 if the block was not allocated
+ */
+int free_space_release(free_space_index_t* index, const subnet_t* subnet) {
+    size_t node = free_space_find_node(index, subnet);
+    if (node == 0 || !index->allocated[node]) {
+        return -1;
+    }
+    //the descendants of an allocated node are never modified, so they are still free
+    index->allocated[node] = 0;
+    index->largest_free[node] = subnet->prefixlen;
+    for (int level = subnet->prefixlen; level <= index->granularity; level++){
+        index->free_blocks[level] += (uint64_t)1 << (level - subnet->prefixlen);
+    }
+    free_space_update_ancestors(index, node, subnet->prefixlen);
+    PROBE2(release, subnet->network_address, subnet->prefixlen);
+    return 0;
+}
+
+/**
+ * @brief Prefix length of the largest free block of the pool
+ * 
+ * @return int prefix length, -1 if the pool is full
+ */
+int free_space_largest_free_prefixlen(const free_space_index_t* index) {
+    return index->largest_free[1] == NO_FREE_BLOCK ? -1 : index->largest_free[1];
+}
+
+/**
+ * @brief Number of free blocks of size /prefixlen, e.g. number of free /24
+ */
+uint64_t free_space_count_free(const free_space_index_t* index, int prefixlen) {
+    assert(index->pool.prefixlen <= prefixlen && prefixlen <= index->granularity);
+    return index->free_blocks[prefixlen];
+}
+
+int64_t free_space_find_first(const free_space_index_t* index, size_t node, int level, uint64_t base, int prefixlen, uint64_t from) {
+    uint64_t block_size = prefix_table[level].num_ip_addresses;
+    if (base + block_size <= from || index->largest_free[node] > prefixlen) {
+        return -1;
+    }
+    if (index->largest_free[node] == level) {
+        //the whole block is free: the answer is the first block of size /prefixlen at or after 'from'
+        uint64_t size = prefix_table[prefixlen].num_ip_addresses;
+        uint64_t candidate = from > base ? (from + size - 1) & ~(size - 1) : base;
+        return candidate < base + block_size ? (int64_t)candidate : -1;
+    }
+    int64_t found = free_space_find_first(index, 2 * node, level + 1, base, prefixlen, from);
+    if (found < 0) {
+        found = free_space_find_first(index, 2 * node + 1, level + 1, base + block_size / 2, prefixlen, from);
+    }
+    return found;
+}
+
+/**
+ * @brief Find the first free block of size /prefixlen whose network address is at or after 'from'
+ * 
+ * @param index 
+ * @param prefixlen 
+ * @param from 
+ * @param subnet out parameter, parameters of the free block found
+ * @return int 0 if found, -1 otherwise
+ */
+int free_space_first_free(const free_space_index_t* index, int prefixlen, uint32_t from, subnet_t* subnet) {
+    assert(index->pool.prefixlen <= prefixlen && prefixlen <= index->granularity);
+    int64_t network_address = free_space_find_first(index, 1, index->pool.prefixlen, index->pool.network_address, prefixlen, from);
+    if (network_address < 0) {
+        return -1;
+    }
+    *subnet = subnet_calculator(network_address, prefixlen);
+    return 0;
+}
+
+/**
+ * @brief Allocate the first free block of size /prefixlen of the pool
+ * 
+ * @return int 0 if successful, -1 if there is no free block big enough
+ */
+int free_space_allocate_first(free_space_index_t* index, int prefixlen, subnet_t* subnet) {
+    if (free_space_first_free(index, prefixlen, index->pool.network_address, subnet) < 0) {
+        return -1;
+    }
+    return free_space_allocate(index, subnet);
+}
+
+void free_space_test_cases() {
+    subnet_t pool = {.network_address = 151587072, .prefixlen = 23};
+    subnet_t target_subnets[] = {{.num_ip_addresses=25}, {.num_ip_addresses=63}, {.num_ip_addresses=10}};
+    size_t num_subnets = 3;
+    vlsm(&pool, target_subnets, num_subnets);
+
+    free_space_index_t index = free_space_index_init(pool, 30);
+    for (size_t i = 0; i < num_subnets; i++){
+        int result = free_space_allocate(&index, &target_subnets[i]);
+        assert(result == 0);
+        (void)result;
+    }
+    printf("largest free prefix: /%d\n", free_space_largest_free_prefixlen(&index));
+    printf("free /24: %" PRIu64 ", free /26: %" PRIu64 "\n", free_space_count_free(&index, 24), free_space_count_free(&index, 26));
+    subnet_t first_free;
+    free_space_first_free(&index, 26, pool.network_address, &first_free);
+    print_formatted_ip_address(first_free.network_address, "first free /26");
+
+    free_space_release(&index, &target_subnets[0]);
+    printf("largest free prefix after releasing %d addresses: /%d\n", target_subnets[0].num_ip_addresses, free_space_largest_free_prefixlen(&index));
+    free_space_index_destroy(&index);
+}
+
+/**
+ * @brief data structure to accumulate utilization and fragmentation statistics of one or several parent subnets
+ * 
+ * Free space is measured as the maximal aligned free blocks between allocations, e.g. the range 10.0.0.64 - 10.0.0.255
+ * is made of the free blocks 10.0.0.64/26 and 10.0.0.128/25.
+ * 
+ * Accumulators are mergeable, so that partial statistics calculated by different threads can be combined
+ */
+typedef struct {
+    uint64_t num_parents;
+    uint64_t num_allocations;
+    uint64_t total_addresses;
+    uint64_t allocated_addresses;
+    uint64_t free_addresses;
+    uint64_t largest_free_block;
+    uint64_t free_block_histogram[33];
+} subnet_stats_t;
+
+/**
+ * @brief Add to the statistics the free range of addresses [start, end)
+ */
+void subnet_stats_add_free_range(subnet_stats_t* stats, uint64_t start, uint64_t end) {
+    stats->free_addresses += end - start;
+    while (start < end) {
+        //largest block aligned at 'start' that does not go past 'end'
+        uint64_t block_size = start == 0 ? (uint64_t)1 << 32 : start & -start;
+        while (block_size > end - start) {
+            block_size /= 2;
+        }
+        stats->free_block_histogram[32 - __builtin_ctzll(block_size)]++;
+        if (block_size > stats->largest_free_block) {
+            stats->largest_free_block = block_size;
+        }
+        start += block_size;
+    }
+}
+
+void subnet_stats_merge(subnet_stats_t* stats, const subnet_stats_t* other) {
+    stats->num_parents += other->num_parents;
+    stats->num_allocations += other->num_allocations;
+    stats->total_addresses += other->total_addresses;
+    stats->allocated_addresses += other->allocated_addresses;
+    stats->free_addresses += other->free_addresses;
+    if (other->largest_free_block > stats->largest_free_block) {
+        stats->largest_free_block = other->largest_free_block;
+    }
+    for (int i = 0; i <= 32; i++){
+        stats->free_block_histogram[i] += other->free_block_histogram[i];
+    }
+}
+
+double subnet_stats_utilization(const subnet_stats_t* stats) {
+    return stats->total_addresses == 0 ? 0 : (double)stats->allocated_addresses / stats->total_addresses;
+}
+
+/**
+ * @brief Fragmentation index: 0 when all the free space is a single block, close to 1 when it is made of many small blocks
+ */
+double subnet_stats_fragmentation(const subnet_stats_t* stats) {
+    return stats->free_addresses == 0 ? 0 : 1 - (double)stats->largest_free_block / stats->free_addresses;
+}
+
+/**
+ * @brief Index of the first allocation whose network address is not lower than 'network_address'
+ */
+size_t lower_bound_subnet(const subnet_t subnets[], size_t num_subnets, uint32_t network_address) {
+    size_t low = 0, high = num_subnets;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (subnets[middle].network_address < network_address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief Calculate in one pass the statistics of the parents in [first_parent, last_parent)
+ */
+void calculate_subnet_stats_range(const subnet_t parents[], size_t first_parent, size_t last_parent, const subnet_t allocations[], size_t num_allocations, subnet_stats_t parent_stats[], subnet_stats_t* fleet_stats) {
+    if (first_parent == last_parent) {
+        return;
+    }
+    size_t j = lower_bound_subnet(allocations, num_allocations, parents[first_parent].network_address);
+    for (size_t i = first_parent; i < last_parent; i++){
+        subnet_stats_t stats = {.num_parents = 1};
+        uint64_t cursor = parents[i].network_address;
+        uint64_t parent_end = (uint64_t)parents[i].broadcast_address + 1;
+        stats.total_addresses = parent_end - cursor;
+        //skip allocations that do not belong to any parent
+        while (j < num_allocations && allocations[j].network_address < cursor) {
+            j++;
+        }
+        for (; j < num_allocations && allocations[j].network_address < parent_end; j++){
+            uint64_t start = allocations[j].network_address;
+            uint64_t end = (uint64_t)allocations[j].broadcast_address + 1;
+            stats.num_allocations++;
+            if (start > cursor) {
+                subnet_stats_add_free_range(&stats, cursor, start);
+                cursor = start;
+            }
+            //allocations nested in previous ones do not add up
+            if (end > cursor) {
+                stats.allocated_addresses += end - cursor;
+                cursor = end;
+            }
+        }
+        if (cursor < parent_end) {
+            subnet_stats_add_free_range(&stats, cursor, parent_end);
+        }
+        parent_stats[i] = stats;
+        subnet_stats_merge(fleet_stats, &stats);
+    }
+}
+
+typedef struct {
+    const subnet_t* parents;
+    const subnet_t* allocations;
+    size_t num_allocations;
+    subnet_stats_t* parent_stats;
+} subnet_stats_worker_args_t;
+
+void subnet_stats_worker(void* context, size_t begin, size_t end, void* result) {
+    subnet_stats_worker_args_t* args = context;
+    calculate_subnet_stats_range(args->parents, begin, end, args->allocations, args->num_allocations, args->parent_stats, result);
+}
+
+void subnet_stats_combine(void* context, void* result, const void* other) {
+    (void)context;
+    subnet_stats_merge(result, other);
+}
+
+/**
+ * @brief Calculate utilization and fragmentation statistics of a set of parent subnets
+ * 
+ * Both parents and allocations must be sorted by network address, parents must not overlap. The parents are split
+ * into ranges that are processed in parallel, each range accumulating its own fleet-wide statistics that are then 
+ * merged.
+ * 
+ * @param parents 
+ * @param num_parents 
+ * @param allocations 
+ * @param num_allocations 
+ * @param parent_stats out parameter, statistics of each parent
+ * @param pool thread pool, NULL to calculate the statistics on the calling thread
+ * @return subnet_stats_t fleet-wide statistics
+ */
+subnet_stats_t calculate_subnet_stats(const subnet_t parents[], size_t num_parents, const subnet_t allocations[], size_t num_allocations, subnet_stats_t parent_stats[], thread_pool_t* pool) {
+    subnet_stats_t identity = {0}, fleet_stats;
+    subnet_stats_worker_args_t args = {parents, allocations, num_allocations, parent_stats};
+    parallel_reduce(pool, 0, num_parents, 0, &identity, sizeof(subnet_stats_t), subnet_stats_worker, subnet_stats_combine, &args, &fleet_stats);
+    return fleet_stats;
+}
+
+void print_subnet_stats_json(FILE* out, const subnet_t* parent, const subnet_stats_t* stats) {
+    fprintf(out, "{");
+    if (parent != NULL) {
+        ip_address_t network = to_dotted_decimal_notation(parent->network_address);
+        fprintf(out, "\"parent\": \"%u.%u.%u.%u/%d\", ", network.byte1, network.byte2, network.byte3, network.byte4, parent->prefixlen);
+    }
+    fprintf(out, "\"parents\": %" PRIu64 ", \"allocations\": %" PRIu64 ", \"total_addresses\": %" PRIu64 ", \"allocated_addresses\": %" PRIu64 ", \"free_addresses\": %" PRIu64 ", ",
+        stats->num_parents, stats->num_allocations, stats->total_addresses, stats->allocated_addresses, stats->free_addresses);
+    fprintf(out, "\"utilization\": %.6f, \"fragmentation\": %.6f, \"free_block_histogram\": {", subnet_stats_utilization(stats), subnet_stats_fragmentation(stats));
+    const char* separator = "";
+    for (int i = 0; i <= 32; i++){
+        if (stats->free_block_histogram[i] > 0) {
+            fprintf(out, "%s\"%d\": %" PRIu64, separator, i, stats->free_block_histogram[i]);
+            separator = ", ";
+        }
+    }
+    fprintf(out, "}}\n");
+}
+
+void print_subnet_stats_csv_header(FILE* out) {
+    fprintf(out, "parent,allocations,total_addresses,allocated_addresses,free_addresses,utilization,fragmentation");
+    for (int i = 0; i <= 32; i++){
+        fprintf(out, ",free_blocks_%d", i);
+    }
+    fprintf(out, "\n");
+}
+
+void print_subnet_stats_csv(FILE* out, const subnet_t* parent, const subnet_stats_t* stats) {
+    ip_address_t network = to_dotted_decimal_notation(parent->network_address);
+    fprintf(out, "%u.%u.%u.%u/%d,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.6f,%.6f", network.byte1, network.byte2, network.byte3, network.byte4, parent->prefixlen,
+        stats->num_allocations, stats->total_addresses, stats->allocated_addresses, stats->free_addresses,
+        subnet_stats_utilization(stats), subnet_stats_fragmentation(stats));
+    for (int i = 0; i <= 32; i++){
+        fprintf(out, ",%" PRIu64, stats->free_block_histogram[i]);
+    }
+    fprintf(out, "\n");
+}
+
+/**
+ * @brief Statistics of a synthetic inventory of 10M allocations in the /16 parents of 0.0.0.0/1
+ */
+void subnet_stats_benchmark() {
+    size_t num_parents = 32768, max_allocations = 10000000, num_allocations = 0;
+    subnet_t* parents = malloc(num_parents * sizeof(subnet_t));
+    subnet_t* allocations = malloc(max_allocations * sizeof(subnet_t));
+    subnet_stats_t* parent_stats = malloc(num_parents * sizeof(subnet_stats_t));
+    uint64_t seed = 28;
+
+    for (size_t i = 0; i < num_parents; i++){
+        parents[i] = subnet_calculator(i << 16, 16);
+        uint64_t cursor = parents[i].network_address;
+        uint64_t parent_end = (uint64_t)parents[i].broadcast_address + 1;
+        while (num_allocations < max_allocations) {
+            int prefixlen = 24 + splitmix64(&seed) % 7;
+            uint64_t size = prefix_table[prefixlen].num_ip_addresses;
+            cursor = ((cursor + size - 1) & ~(size - 1)) + size * (splitmix64(&seed) % 4);
+            if (cursor + size > parent_end) {
+                break;
+            }
+            allocations[num_allocations++] = subnet_calculator(cursor, prefixlen);
+            cursor += size;
+        }
+    }
+
+    thread_pool_t* pool = default_thread_pool();
+    int num_threads = thread_pool_num_workers(pool);
+    double start = now_seconds();
+    subnet_stats_t fleet_stats = calculate_subnet_stats(parents, num_parents, allocations, num_allocations, parent_stats, pool);
+    double elapsed = now_seconds() - start;
+    printf("statistics of %zu allocations in %zu parents calculated in %.3f ms using %d threads\n", num_allocations, num_parents, elapsed * 1e3, num_threads);
+    print_subnet_stats_json(stdout, NULL, &fleet_stats);
+    print_subnet_stats_csv_header(stdout);
+    print_subnet_stats_csv(stdout, &parents[0], &parent_stats[0]);
+
+    free(parent_stats);
+    free(allocations);
+    free(parents);
+}
+
+/**
+ * @brief data structure to represent an inventory of allocated subnets, each one with a label
+ * 
+ * e.g. 10.1.0.0/24 web-frontend
+ */
+typedef struct {
+    subnet_t* subnets;
+    char** labels;
+    size_t num_subnets;
+} inventory_t;
+
+/**
+ * @brief Parse a subnet in the format a.b.c.d/n
+ * 
+ * @return int number of characters parsed, 0 if the text is not a valid subnet
+ */
+int parse_subnet(const char* text, subnet_t* subnet) {
+    unsigned int byte1, byte2, byte3, byte4;
+    int prefixlen, length;
+    if (sscanf(text, "%u.%u.%u.%u/%d%n", &byte1, &byte2, &byte3, &byte4, &prefixlen, &length) != 5
+        || byte1 > 255 || byte2 > 255 || byte3 > 255 || byte4 > 255 || prefixlen < 0 || prefixlen > 32) {
+        return 0;
+    }
+    *subnet = subnet_calculator(to_int((ip_address_t) {byte1, byte2, byte3, byte4}), prefixlen);
+    return length;
+}
+
+/**
+ * @brief Load an inventory file, one subnet per line followed by its label
+ * 
+ * Empty lines and lines starting with '#' are ignored
+ * 
+ * @return int 0 if successful, -1 if the file cannot be read or contains invalid lines
+ */
+int load_inventory(const char* path, inventory_t* inventory) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    size_t capacity = 1024;
+    *inventory = (inventory_t) {malloc(capacity * sizeof(subnet_t)), malloc(capacity * sizeof(char*)), 0};
+    char line[1024];
+    int result = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        subnet_t subnet;
+        int length = parse_subnet(line, &subnet);
+        if (length == 0) {
+            result = -1;
+            break;
+        }
+        if (inventory->num_subnets == capacity) {
+            capacity *= 2;
+            inventory->subnets = realloc(inventory->subnets, capacity * sizeof(subnet_t));
+            inventory->labels = realloc(inventory->labels, capacity * sizeof(char*));
+        }
+        const char* label = line + length + strspn(line + length, " \t");
+        inventory->subnets[inventory->num_subnets] = subnet;
+        inventory->labels[inventory->num_subnets] = strdup(label);
+        inventory->num_subnets++;
+    }
+    fclose(file);
+    return result;
+}
+
+void free_inventory(inventory_t* inventory) {
+    for (size_t i = 0; i < inventory->num_subnets; i++){
+        free(inventory->labels[i]);
+    }
+    free(inventory->labels);
+    free(inventory->subnets);
+}
+
+/**
+ * @brief data structure to find the longest prefix match (LPM) of an ip address among a set of subnets
+ * 
+ * Nested subnets are flattened into disjoint intervals of addresses, each of them owned by the most specific
+ * subnet that contains it (-1 if none), so that a lookup is a binary search of the interval that contains the address.
+ * 
+ * e.g. {10.0.0.0/8, 10.1.0.0/16} is flattened into:
+ * 
+ * 0.0.0.0 -> -1
+ * 10.0.0.0 -> 0
+ * 10.1.0.0 -> 1
+ * 10.2.0.0 -> 0
+ * 11.0.0.0 -> -1
+ */
+typedef struct {
+    uint32_t* starts;
+    int32_t* owners;
+    size_t num_intervals;
+} lpm_table_t;
+
+/**
+ * @brief sort key of a subnet while building the LPM table, carried by value so that concurrent builds do not share
+ * a comparator context
+ */
+typedef struct {
+    uint32_t network_address;
+    int32_t prefixlen;
+    int32_t index;
+} lpm_sort_record_t;
+
+int compare_lpm_records(const void* a, const void* b) {
+    const lpm_sort_record_t* record_a = a;
+    const lpm_sort_record_t* record_b = b;
+    if (record_a->network_address != record_b->network_address) {
+        return record_a->network_address < record_b->network_address ? -1 : 1;
+    }
+    if (record_a->prefixlen != record_b->prefixlen) {
+        return record_a->prefixlen - record_b->prefixlen;
+    }
+    return (record_a->index > record_b->index) - (record_a->index < record_b->index);
+}
+
+void lpm_table_append(lpm_table_t* table, uint64_t start, uint64_t end, int32_t owner) {
+    if (start >= end) {
+        return;
+    }
+    if (table->num_intervals > 0 && table->owners[table->num_intervals - 1] == owner) {
+        return;
+    }
+    table->starts[table->num_intervals] = start;
+    table->owners[table->num_intervals] = owner;
+    table->num_intervals++;
+}
+
+/**
+ * @brief Build the LPM table of a set of subnets
+ * 
+ * The owner of each interval is the index of the subnet in the array 'subnets'. When the same prefix appears several
+ * times, the first one owns it and the others are ignored. Unsorted inputs are sorted by the workers of 'pool'.
+ */
+lpm_table_t lpm_table_build(const subnet_t subnets[], size_t num_subnets, thread_pool_t* pool) {
+    uint64_t probe_start = PROBE_IS_ENABLED(index_rebuild) ? now_nanoseconds() : 0;
+    lpm_sort_record_t* records = malloc(num_subnets * sizeof(lpm_sort_record_t));
+    for (size_t i = 0; i < num_subnets; i++){
+        records[i] = (lpm_sort_record_t){.network_address = subnets[i].network_address, .prefixlen = subnets[i].prefixlen, .index = i};
+    }
+    //inputs such as routing tables are usually sorted already
+    size_t num_sorted = 1;
+    while (num_sorted < num_subnets && compare_lpm_records(&records[num_sorted - 1], &records[num_sorted]) <= 0) {
+        num_sorted++;
+    }
+    if (num_sorted < num_subnets) {
+        parallel_sort(pool, records, num_subnets, sizeof(lpm_sort_record_t), 0, compare_lpm_records);
+    }
+    //duplicates are adjacent once sorted, the first owner sorts first
+    size_t num_unique = 0;
+    for (size_t i = 0; i < num_subnets; i++){
+        if (num_unique > 0 && records[num_unique - 1].network_address == records[i].network_address
+            && records[num_unique - 1].prefixlen == records[i].prefixlen) {
+            continue;
+        }
+        records[num_unique++] = records[i];
+    }
+
+    //each subnet opens at most 2 intervals: its own and the one of its parent after it
+    lpm_table_t table = {malloc((2 * num_subnets + 1) * sizeof(uint32_t)), malloc((2 * num_subnets + 1) * sizeof(int32_t)), 0};
+    //stack of the subnets that contain the current address, the most specific one on top
+    int32_t stack[33];
+    int stack_size = 0;
+    uint64_t cursor = 0;
+    for (size_t i = 0; i < num_unique; i++){
+        const subnet_t* subnet = &subnets[records[i].index];
+        while (stack_size > 0 && (uint64_t)subnets[stack[stack_size - 1]].broadcast_address + 1 <= subnet->network_address) {
+            uint64_t end = (uint64_t)subnets[stack[stack_size - 1]].broadcast_address + 1;
+            lpm_table_append(&table, cursor, end, stack[stack_size - 1]);
+            cursor = end;
+            stack_size--;
+        }
+        lpm_table_append(&table, cursor, subnet->network_address, stack_size > 0 ? stack[stack_size - 1] : -1);
+        cursor = subnet->network_address;
+        //distinct nested prefixes have distinct lengths, so at most 33 of them contain an address
+        assert(stack_size < 33);
+        stack[stack_size++] = records[i].index;
+    }
+    while (stack_size > 0) {
+        uint64_t end = (uint64_t)subnets[stack[stack_size - 1]].broadcast_address + 1;
+        lpm_table_append(&table, cursor, end, stack[stack_size - 1]);
+        cursor = end;
+        stack_size--;
+    }
+    lpm_table_append(&table, cursor, (uint64_t)1 << 32, -1);
+
+    free(records);
+    PROBE3(index_rebuild, num_subnets, table.num_intervals, probe_start != 0 ? now_nanoseconds() - probe_start : 0);
+    return table;
+}
+
+void lpm_table_destroy(lpm_table_t* table) {
+    free(table->starts);
+    free(table->owners);
+}
+
+/**
+ * @brief Find the most specific subnet that contains 'ip_address'
+ * 
+ * @return int32_t index of the subnet, -1 if none contains the ip address
+ */
+int32_t lpm_lookup(const lpm_table_t* table, uint32_t ip_address) {
+    INSTRUMENT_BEGIN(OP_LPM_LOOKUP);
+    //last interval whose start is not greater than the ip address, there is always one starting at 0.0.0.0
+    size_t low = 0, high = table->num_intervals;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (table->starts[middle] <= ip_address) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    INSTRUMENT_END(OP_LPM_LOOKUP);
+    return table->owners[low];
+}
+
+#define LPM_BATCH_GROUP_SIZE 16
+
+/**
+ * @brief Find the most specific subnet that contains each of the ip addresses
+ * 
+ * The binary searches of a group of LPM_BATCH_GROUP_SIZE ip addresses advance in lockstep, as all of them take the same
+ * number of steps. The interval probed by the next step of each search is prefetched while the rest of the group is
+ * processed, so that the cache misses of the group overlap instead of following one another.
+ */
+void lpm_lookup_batch(const lpm_table_t* table, const uint32_t ip_addresses[], size_t num_ip_addresses, int32_t owners[]) {
+    INSTRUMENT_BEGIN(OP_LPM_LOOKUP_BATCH);
+    const uint32_t* starts = table->starts;
+    for (size_t first = 0; first < num_ip_addresses; first += LPM_BATCH_GROUP_SIZE){
+        size_t group_size = num_ip_addresses - first < LPM_BATCH_GROUP_SIZE ? num_ip_addresses - first : LPM_BATCH_GROUP_SIZE;
+        const uint32_t* group = ip_addresses + first;
+        size_t lows[LPM_BATCH_GROUP_SIZE] = {0};
+        for (size_t length = table->num_intervals; length > 1; ){
+            size_t half = length / 2;
+            size_t next_half = (length - half) / 2;
+            for (size_t i = 0; i < group_size; i++){
+                size_t low = starts[lows[i] + half] <= group[i] ? lows[i] + half : lows[i];
+                lows[i] = low;
+                __builtin_prefetch(&starts[low + next_half]);
+            }
+            length -= half;
+        }
+        for (size_t i = 0; i < group_size; i++){
+            __builtin_prefetch(&table->owners[lows[i]]);
+        }
+        for (size_t i = 0; i < group_size; i++){
+            owners[first + i] = table->owners[lows[i]];
+        }
+    }
+    INSTRUMENT_END(OP_LPM_LOOKUP_BATCH);
+}
+
+/**
+ * @brief data structure to represent a growable buffer of text
+ */
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} text_buffer_t;
+
+void text_buffer_reserve(text_buffer_t* buffer, size_t length) {
+    if (buffer->length + length > buffer->capacity) {
+        buffer->capacity = 2 * (buffer->length + length);
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+}
+
+void text_buffer_append(text_buffer_t* buffer, const char* text, size_t length) {
+    text_buffer_reserve(buffer, length);
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+}
+
+/**
+ * @brief data structure to represent an ip address found in a text
+ */
+typedef struct {
+    uint32_t offset;
+    uint32_t ip_address;
+    uint8_t length;
+} ipv4_match_t;
+
+int is_ipv4_char(char c) {
+    return (c >= '0' && c <= '9') || c == '.';
+}
+
+/**
+ * @brief Parse a run of digits and dots that must be exactly an ip address in dotted decimal notation
+ * 
+ * @return int 1 if valid, 0 otherwise
+ */
+int parse_ipv4_run(const char* run, size_t length, uint32_t* ip_address) {
+    uint32_t result = 0, byte = 0;
+    int num_bytes = 0, num_digits = 0;
+    for (size_t i = 0; i < length; i++){
+        if (run[i] == '.') {
+            if (num_digits == 0 || ++num_bytes == 4) {
+                return 0;
+            }
+            result = result << 8 | byte;
+            byte = 0;
+            num_digits = 0;
+        } else {
+            byte = byte * 10 + (run[i] - '0');
+            if (++num_digits > 3 || byte > 255) {
+                return 0;
+            }
+        }
+    }
+    if (num_digits == 0 || num_bytes != 3) {
+        return 0;
+    }
+    *ip_address = result << 8 | byte;
+    return 1;
+}
+
+/**
+ * @brief Validate the run of digits and dots [start, end) of 'text' and append it to 'matches' if it is an ip address
+ * 
+ * Leading and trailing dots are not part of the ip address, e.g. "...10.0.0.1." contains 10.0.0.1
+ */
+size_t add_ipv4_match(const char* text, size_t start, size_t end, ipv4_match_t matches[], size_t num_matches) {
+    while (start < end && text[start] == '.') {
+        start++;
+    }
+    while (end > start && text[end - 1] == '.') {
+        end--;
+    }
+    uint32_t ip_address;
+    if (end - start >= 7 && end - start <= 15 && parse_ipv4_run(text + start, end - start, &ip_address)) {
+        matches[num_matches++] = (ipv4_match_t) {start, ip_address, end - start};
+    }
+    return num_matches;
+}
+
+/**
+ * @brief Scalar version of 'scan_ipv4_addresses', used for the end of the text and as a reference
+ */
+size_t scan_ipv4_addresses_scalar(const char* text, size_t length, ipv4_match_t matches[], size_t max_matches) {
+    size_t num_matches = 0;
+    size_t i = 0;
+    while (i < length && num_matches < max_matches) {
+        if (!is_ipv4_char(text[i])) {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < length && is_ipv4_char(text[i])) {
+            i++;
+        }
+        num_matches = add_ipv4_match(text, start, i, matches, num_matches);
+    }
+    return num_matches;
+}
+
+/**
+ * @brief Bit mask of the characters of a block of 64 bytes that are digits or dots, bit 'i' corresponds to byte 'i'
+ */
+uint64_t ipv4_char_mask(const char* block) {
+#if defined(__AVX2__)
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; i += 32){
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(block + i));
+        //'.' is followed by '/' and then the digits, so subtracting '.' maps digits and dots to [0, 11]
+        __m256i shifted = _mm256_sub_epi8(chunk, _mm256_set1_epi8('.'));
+        __m256i in_range = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(11)), shifted);
+        __m256i slash = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('/'));
+        mask |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_andnot_si256(slash, in_range)) << i;
+    }
+    return mask;
+#elif defined(__SSE2__)
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; i += 16){
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(block + i));
+        //'.' is followed by '/' and then the digits, so subtracting '.' maps digits and dots to [0, 11]
+        __m128i shifted = _mm_sub_epi8(chunk, _mm_set1_epi8('.'));
+        __m128i in_range = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(11)), shifted);
+        __m128i slash = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('/'));
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_andnot_si128(slash, in_range)) << i;
+    }
+    return mask;
+#else
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; i++){
+        mask |= (uint64_t)is_ipv4_char(block[i]) << i;
+    }
+    return mask;
+#endif
+}
+
+/**
+ * @brief Find all the ip addresses in dotted decimal notation embedded in a text
+ * 
+ * An ip address is a maximal run of digits and dots, so e.g. version numbers such as 1.2.3.4.5 are not reported.
+ * The search stops when 'max_matches' addresses are found, it can be resumed after the end of the last match.
+ * 
+ * The text is processed in blocks of 64 bytes: a vectorized comparison produces the bit mask of digits and dots
+ * of the block, and the runs are extracted from the mask with bit operations, so that blocks without candidates
+ * are skipped at once and only the runs are validated byte by byte.
+ * 
+ * @param text 
+ * @param length 
+ * @param matches out parameter, offset, length and value of each ip address found
+ * @param max_matches 
+ * @return size_t number of ip addresses found
+ */
+size_t scan_ipv4_addresses(const char* text, size_t length, ipv4_match_t matches[], size_t max_matches) {
+    size_t num_matches = 0;
+    size_t i = 0;
+    //'i' is never in the middle of a run: runs that reach the end of a block are completed before moving on
+    while (length - i >= 64 && num_matches < max_matches) {
+        uint64_t mask = ipv4_char_mask(text + i);
+        size_t next_block = i + 64;
+        while (mask != 0 && num_matches < max_matches) {
+            int run_start = __builtin_ctzll(mask);
+            uint64_t non_ipv4_chars = ~mask & (~(uint64_t)0 << run_start);
+            if (non_ipv4_chars == 0) {
+                size_t end = i + 64;
+                while (end < length && is_ipv4_char(text[end])) {
+                    end++;
+                }
+                num_matches = add_ipv4_match(text, i + run_start, end, matches, num_matches);
+                next_block = end;
+                break;
+            }
+            int run_end = __builtin_ctzll(non_ipv4_chars);
+            num_matches = add_ipv4_match(text, i + run_start, i + run_end, matches, num_matches);
+            mask &= ~(uint64_t)0 << run_end;
+        }
+        i = next_block;
+    }
+    if (num_matches < max_matches && i < length) {
+        size_t num_tail_matches = scan_ipv4_addresses_scalar(text + i, length - i, matches + num_matches, max_matches - num_matches);
+        for (size_t j = num_matches; j < num_matches + num_tail_matches; j++){
+            matches[j].offset += i;
+        }
+        num_matches += num_tail_matches;
+    }
+    return num_matches;
+}
+
+/**
+ * @brief Append to 'corpus' synthetic log lines of the kinds usually found in logs: syslog, JSON and HTTP headers
+ */
+void generate_log_corpus(text_buffer_t* corpus, size_t length, uint64_t seed) {
+    char line[512];
+    while (corpus->length < length) {
+        uint64_t r = splitmix64(&seed);
+        unsigned int a = r & 0xFF, b = r >> 8 & 0xFF, c = r >> 16 & 0xFF, d = r >> 24 & 0xFF;
+        int line_length;
+        switch (r >> 32 & 3) {
+            case 0:
+                line_length = snprintf(line, sizeof(line), "Oct 16 10:%02u:%02u gw01 sshd[%u]: Accepted publickey for deploy from 10.%u.%u.%u port %u ssh2\n",
+                    a % 60, b % 60, (unsigned int)(r >> 40 & 0xFFFF), b, c, d, 1024 + (unsigned int)(r >> 48));
+                break;
+            case 1:
+                line_length = snprintf(line, sizeof(line), "{\"ts\":\"2026-10-16T10:%02u:%02u.%03uZ\",\"level\":\"info\",\"src\":\"172.16.%u.%u\",\"dst\":\"10.0.%u.%u\",\"bytes\":%u,\"version\":\"1.2.3.4.5\"}\n",
+                    a % 60, b % 60, c % 1000, a, b, c, d, (unsigned int)(r >> 40));
+                break;
+            case 2:
+                line_length = snprintf(line, sizeof(line), "X-Forwarded-For: %u.%u.%u.%u, 192.168.%u.%u\r\nHost: api.example.com\r\nUser-Agent: curl/8.4.0\n",
+                    a, b, c, d, c, d);
+                break;
+            default:
+                line_length = snprintf(line, sizeof(line), "%u.%u.%u.%u - - [16/Oct/2026:10:%02u:%02u +0000] \"GET /api/v1/items/%u HTTP/1.1\" 200 %u \"-\" \"Mozilla/5.0 (X11; Linux x86_64)\"\n",
+                    a, b, c, d, a % 60, b % 60, (unsigned int)(r >> 40), (unsigned int)(r >> 48));
+        }
+        text_buffer_append(corpus, line, line_length);
+    }
+}
+
+void scan_ipv4_test_cases() {
+    //a run placed around the end of the first block of 64 bytes, followed by addresses in the second block and in the tail
+    struct {
+        size_t position;
+        const char* run;
+        size_t num_addresses;
+    } cases[] = {
+        {56, "10.1.2.3", 3},        //ends exactly at byte 63
+        {60, "10.20.30.40", 3},     //spills into the next block
+        {57, "1.2.3.4.5", 2},       //1.2.3.4 ends at byte 63, but the run goes on and is not an ip address
+        {62, "..192.0.2.1.", 3},    //leading dots in the first block, trailing dot in the next one
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++){
+        char text[160];
+        memset(text, ' ', sizeof(text));
+        memcpy(text + cases[c].position, cases[c].run, strlen(cases[c].run));
+        memcpy(text + 100, "172.16.0.1", 10);
+        memcpy(text + 140, "10.0.0.1", 8);
+        //every 'max_matches' up to more than the number of addresses, so that the search also stops inside a block
+        for (size_t max_matches = 0; max_matches <= cases[c].num_addresses + 1; max_matches++){
+            ipv4_match_t matches[4], expected[4];
+            size_t num_matches = scan_ipv4_addresses(text, sizeof(text), matches, max_matches);
+            size_t num_expected = scan_ipv4_addresses_scalar(text, sizeof(text), expected, max_matches);
+            assert(num_matches == num_expected);
+            assert(num_expected == (max_matches < cases[c].num_addresses ? max_matches : cases[c].num_addresses));
+            for (size_t i = 0; i < num_matches; i++){
+                assert(matches[i].offset == expected[i].offset && matches[i].ip_address == expected[i].ip_address
+                    && matches[i].length == expected[i].length);
+            }
+        }
+        ipv4_match_t first;
+        scan_ipv4_addresses(text, sizeof(text), &first, 1);
+        printf("%-14s at byte %2zu: first match at byte %u, %u characters\n", cases[c].run, cases[c].position, first.offset, first.length);
+    }
+}
+
+/**
+ * @brief Compare the throughput of the vectorized and scalar ip address scanners on a synthetic log corpus of 256MB
+ */
+void scan_ipv4_benchmark() {
+    text_buffer_t corpus = {0};
+    generate_log_corpus(&corpus, 256 << 20, 30);
+    size_t max_matches = 1 << 16;
+    ipv4_match_t* matches = malloc(max_matches * sizeof(ipv4_match_t));
+
+    size_t (*scanners[])(const char*, size_t, ipv4_match_t[], size_t) = {scan_ipv4_addresses, scan_ipv4_addresses_scalar};
+    const char* names[] = {"vectorized", "scalar"};
+    size_t total_matches[2];
+    uint64_t checksums[2];
+    for (int k = 0; k < 2; k++){
+        size_t num_matches = 0;
+        uint64_t checksum = 0;
+        double start = now_seconds();
+        size_t offset = 0;
+        while (offset < corpus.length) {
+            size_t found = scanners[k](corpus.data + offset, corpus.length - offset, matches, max_matches);
+            for (size_t i = 0; i < found; i++){
+                checksum += matches[i].ip_address;
+            }
+            num_matches += found;
+            offset = found < max_matches ? corpus.length : offset + matches[found - 1].offset + matches[found - 1].length;
+        }
+        double elapsed = now_seconds() - start;
+        printf("%s scanner: %zu ip addresses (checksum %" PRIu64 ") in %.1f MB at %.2f GB/s\n", names[k], num_matches,
+            checksum, corpus.length / 1e6, corpus.length / elapsed / 1e9);
+        total_matches[k] = num_matches;
+        checksums[k] = checksum;
+    }
+    assert(total_matches[0] == total_matches[1] && checksums[0] == checksums[1]);
+
+    free(matches);
+    free(corpus.data);
+}
+
+/**
+ * @brief Write an ip address in dotted decimal notation, the buffer must have room for 15 characters
+ * 
+ * @return int number of characters written
+ */
+int format_ip_address(char* buffer, uint32_t ip_address) {
+    char* start = buffer;
+    for (int shift = 24; shift >= 0; shift -= 8){
+        unsigned int byte = ip_address >> shift & 0xFF;
+        if (byte >= 100) {
+            *buffer++ = '0' + byte / 100;
+        }
+        if (byte >= 10) {
+            *buffer++ = '0' + byte / 10 % 10;
+        }
+        *buffer++ = '0' + byte % 10;
+        if (shift > 0) {
+            *buffer++ = '.';
+        }
+    }
+    return buffer - start;
+}
+
+/**
+ * @brief Write an unsigned integer in decimal, the buffer must have room for 10 characters
+ * 
+ * @return int number of characters written
+ */
+int format_decimal(char* buffer, uint32_t value) {
+    char digits[10];
+    int num_digits = 0;
+    do {
+        digits[num_digits++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    for (int i = 0; i < num_digits; i++){
+        buffer[i] = digits[num_digits - 1 - i];
+    }
+    return num_digits;
+}
+
+#define MAX_IPV4_MATCHES_PER_LINE 256
+
+/**
+ * @brief Annotate each line of a text with the subnet of the inventory that contains each ip address of the line
+ * 
+ * The annotations are appended to the end of the line, separated by tabs:
+ * 
+ * <line>\t<ip address>=<network address>/<prefix length>,<label>...
+ * 
+ * ip addresses that do not belong to any subnet of the inventory are not annotated. The annotations of a line ending
+ * in \r\n are inserted before the \r, so that CRLF lines remain CRLF lines.
+ */
+void enrich_lines(const char* text, size_t length, const inventory_t* inventory, const lpm_table_t* table, text_buffer_t* output) {
+    ipv4_match_t matches[MAX_IPV4_MATCHES_PER_LINE];
+    uint32_t ip_addresses[MAX_IPV4_MATCHES_PER_LINE];
+    int32_t owners[MAX_IPV4_MATCHES_PER_LINE];
+    const char* end = text + length;
+    while (text < end) {
+        const char* newline = memchr(text, '\n', end - text);
+        size_t line_length = (newline != NULL ? newline : end) - text;
+        int carriage_return = line_length > 0 && text[line_length - 1] == '\r';
+        line_length -= carriage_return;
+        text_buffer_append(output, text, line_length);
+
+        //lines with more than MAX_IPV4_MATCHES_PER_LINE ip addresses are scanned again after the last match
+        size_t offset = 0, num_matches;
+        do {
+            num_matches = scan_ipv4_addresses(text + offset, line_length - offset, matches, MAX_IPV4_MATCHES_PER_LINE);
+            for (size_t i = 0; i < num_matches; i++){
+                ip_addresses[i] = matches[i].ip_address;
+            }
+            lpm_lookup_batch(table, ip_addresses, num_matches, owners);
+            for (size_t i = 0; i < num_matches; i++){
+                if (owners[i] < 0) {
+                    continue;
+                }
+                const subnet_t* subnet = &inventory->subnets[owners[i]];
+                const char* label = inventory->labels[owners[i]];
+                size_t label_length = strlen(label);
+                text_buffer_reserve(output, label_length + 40);
+                char* annotation = output->data + output->length;
+                *annotation++ = '\t';
+                annotation += format_ip_address(annotation, matches[i].ip_address);
+                *annotation++ = '=';
+                annotation += format_ip_address(annotation, subnet->network_address);
+                annotation += sprintf(annotation, "/%d,", subnet->prefixlen);
+                memcpy(annotation, label, label_length);
+                output->length = annotation + label_length - output->data;
+            }
+            if (num_matches == MAX_IPV4_MATCHES_PER_LINE) {
+                offset += matches[num_matches - 1].offset + matches[num_matches - 1].length;
+            }
+        } while (num_matches == MAX_IPV4_MATCHES_PER_LINE);
+        if (carriage_return) {
+            text_buffer_append(output, "\r", 1);
+        }
+        //the last line of the input may have no newline, the output keeps it that way
+        if (newline != NULL) {
+            text_buffer_append(output, "\n", 1);
+        }
+        text = text + line_length + carriage_return + 1;
+    }
+}
+
+typedef struct {
+    const char* text;
+    size_t length;
+    const inventory_t* inventory;
+    const lpm_table_t* table;
+    text_buffer_t output;
+} enrich_worker_args_t;
+
+void enrich_worker(void* context, size_t begin, size_t end) {
+    enrich_worker_args_t* slices = context;
+    for (size_t i = begin; i < end; i++){
+        enrich_lines(slices[i].text, slices[i].length, slices[i].inventory, slices[i].table, &slices[i].output);
+    }
+}
+
+#define ENRICH_SLICES_PER_WORKER 4
+
+#define ENRICH_BLOCK_SIZE (16 << 20)
+
+/**
+ * @brief Annotate the ip addresses of the lines read from 'in' with the subnets of the inventory and write them to 'out'
+ * 
+ * The input is read in large blocks of complete lines. Each block is split into a few slices of complete lines per
+ * worker of 'pool', that are annotated in parallel and written in the original order.
+ * 
+ * @return int 0 if successful, -1 if the inventory cannot be loaded or the output cannot be written
+ */
+int enrich_log(const char* inventory_path, FILE* in, FILE* out, thread_pool_t* pool) {
+    inventory_t inventory;
+    if (load_inventory(inventory_path, &inventory) < 0) {
+        return -1;
+    }
+    lpm_table_t table = lpm_table_build(inventory.subnets, inventory.num_subnets, pool);
+    int num_slices = ENRICH_SLICES_PER_WORKER * thread_pool_num_workers(pool);
+    enrich_worker_args_t args[num_slices];
+    for (int i = 0; i < num_slices; i++){
+        args[i] = (enrich_worker_args_t) {.inventory = &inventory, .table = &table};
+    }
+
+    char* block = malloc(ENRICH_BLOCK_SIZE);
+    size_t pending = 0;
+    int result = 0;
+    while (result == 0) {
+        size_t length = pending + fread(block + pending, 1, ENRICH_BLOCK_SIZE - pending, in);
+        if (length == 0) {
+            break;
+        }
+        //only complete lines are processed, unless it is the end of the input or a line longer than the block
+        size_t complete = length;
+        if (length == ENRICH_BLOCK_SIZE) {
+            const char* last_newline = block + length;
+            while (last_newline > block && last_newline[-1] != '\n') {
+                last_newline--;
+            }
+            if (last_newline > block) {
+                complete = last_newline - block;
+            }
+        }
+
+        size_t slice_start = 0;
+        for (int i = 0; i < num_slices; i++){
+            size_t slice_end = complete * (i + 1) / num_slices;
+            while (slice_end > 0 && slice_end < complete && block[slice_end - 1] != '\n') {
+                slice_end++;
+            }
+            if (slice_end < slice_start) {
+                slice_end = slice_start;
+            }
+            args[i].text = block + slice_start;
+            args[i].length = slice_end - slice_start;
+            args[i].output.length = 0;
+            slice_start = slice_end;
+        }
+        parallel_for(pool, 0, num_slices, 1, enrich_worker, args);
+        for (int i = 0; i < num_slices && result == 0; i++){
+            if (fwrite(args[i].output.data, 1, args[i].output.length, out) != args[i].output.length) {
+                result = -1;
+            }
+        }
+
+        pending = length - complete;
+        memmove(block, block + complete, pending);
+    }
+    if (fflush(out) != 0) {
+        result = -1;
+    }
+
+    free(block);
+    for (int i = 0; i < num_slices; i++){
+        free(args[i].output.data);
+    }
+    lpm_table_destroy(&table);
+    free_inventory(&inventory);
+    return result;
+}
+
+void enrich_test_cases() {
+    subnet_t subnets[] = {subnet_calculator(0x0A000000, 8), subnet_calculator(0x0A010000, 16)};
+    char* labels[] = {"corporate", "lab"};
+    inventory_t inventory = {subnets, labels, 2};
+    lpm_table_t table = lpm_table_build(subnets, 2, default_thread_pool());
+    const char* text = "a 10.1.2.3\r\nb 192.0.2.1\r\n\r\nc 10.2.3.4 10.1.0.1\nd 10.0.0.1\r";
+    const char* expected = "a 10.1.2.3\t10.1.2.3=10.1.0.0/16,lab\r\n"
+        "b 192.0.2.1\r\n"
+        "\r\n"
+        "c 10.2.3.4 10.1.0.1\t10.2.3.4=10.0.0.0/8,corporate\t10.1.0.1=10.1.0.0/16,lab\n"
+        "d 10.0.0.1\t10.0.0.1=10.0.0.0/8,corporate\r";
+    text_buffer_t output = {0};
+    enrich_lines(text, strlen(text), &inventory, &table, &output);
+    printf("%.*s\n", (int)output.length, output.data);
+    assert(output.length == strlen(expected) && memcmp(output.data, expected, output.length) == 0);
+    free(output.data);
+    lpm_table_destroy(&table);
+}
+
+/**
+ * @brief Enrichment throughput, including the load of the inventory, of a synthetic log of 256MB annotated with an
+ * inventory of 64K subnets, for an increasing number of workers
+ */
+void enrich_benchmark() {
+    char inventory_path[] = "/tmp/enrich_inventory_XXXXXX";
+    int fd = mkstemp(inventory_path);
+    if (fd < 0) {
+        return;
+    }
+    FILE* inventory = fdopen(fd, "w");
+    fprintf(inventory, "10.0.0.0/8 corporate\n172.16.0.0/12 datacenter\n");
+    for (int i = 0; i < 65536; i++){
+        fprintf(inventory, "10.%d.%d.0/24 vlan-%d\n", i >> 8, i & 0xFF, i);
+    }
+    fclose(inventory);
+    text_buffer_t corpus = {0};
+    generate_log_corpus(&corpus, 256 << 20, 29);
+    FILE* out = fopen("/dev/null", "w");
+
+    printf("%-8s %8s %14s %8s\n", "workers", "GB/s", "GB/s per core", "speedup");
+    double baseline = 0;
+    for (int num_workers = 1; num_workers <= num_cpus(); num_workers = next_num_workers(num_workers)){
+        thread_pool_t* pool = thread_pool_create(num_workers);
+        FILE* in = fmemopen(corpus.data, corpus.length, "r");
+        double start = now_seconds();
+        int result = enrich_log(inventory_path, in, out, pool);
+        double elapsed = now_seconds() - start;
+        fclose(in);
+        thread_pool_destroy(pool);
+        assert(result == 0);
+        (void)result;
+        if (num_workers == 1) {
+            baseline = elapsed;
+        }
+        double throughput = corpus.length / elapsed / 1e9;
+        printf("%-8d %8.2f %14.2f %7.1fx\n", num_workers, throughput, throughput / num_workers, baseline / elapsed);
+    }
+
+    fclose(out);
+    free(corpus.data);
+    unlink(inventory_path);
+}
+
+/**
+ * @brief Mix the bits of a 64-bit key, used to index hash tables
+ */
+uint64_t hash_u64(uint64_t key) {
+    key = (key ^ (key >> 33)) * 0xFF51AFD7ED558CCD;
+    key = (key ^ (key >> 33)) * 0xC4CEB9FE1A85EC53;
+    return key ^ (key >> 33);
+}
+
+#define ACL_PERMIT 1
+#define ACL_DENY 0
+
+/**
+ * @brief data structure to represent a rule of an access control list
+ * 
+ * A flow matches the rule if its source and destination addresses belong to the subnets 'source' and 'destination',
+ * its ports are within the port ranges and its protocol is 'protocol' (0 matches any protocol). Only the network
+ * address and prefix length of the subnets are used, host bits of the network address are ignored.
+ */
+typedef struct {
+    subnet_t source;
+    subnet_t destination;
+    uint16_t min_source_port;
+    uint16_t max_source_port;
+    uint16_t min_destination_port;
+    uint16_t max_destination_port;
+    uint8_t protocol;
+    int action;
+} acl_rule_t;
+
+/**
+ * @brief data structure to represent a flow by its 5-tuple
+ */
+typedef struct {
+    uint32_t source_address;
+    uint32_t destination_address;
+    uint16_t source_port;
+    uint16_t destination_port;
+    uint8_t protocol;
+} flow_t;
+
+/**
+ * @brief data structure to represent the rules with the same source and destination prefix lengths (tuple)
+ * 
+ * The rules are stored in a hash table whose key is the pair (source network, destination network), each entry being
+ * the chain of rules with that key in order of priority
+ */
+typedef struct {
+    int source_prefixlen;
+    int destination_prefixlen;
+    uint32_t source_mask;
+    uint32_t destination_mask;
+    int32_t best_rule;
+    size_t capacity;
+    uint64_t* keys;
+    int32_t* heads;
+} acl_tuple_t;
+
+/**
+ * @brief data structure to classify flows according to an access control list using tuple space search
+ * 
+ * The priority of a rule is its position in the list, the first rule that matches the flow is applied.
+ * The tuples are sorted by the priority of their best rule, so that the search stops as soon as no remaining tuple
+ * can contain a rule better than the one found.
+ */
+typedef struct {
+    const acl_rule_t* rules;
+    size_t num_rules;
+    int32_t* next_rule;
+    acl_tuple_t* tuples;
+    size_t num_tuples;
+} acl_classifier_t;
+
+uint64_t acl_key(uint32_t source_network, uint32_t destination_network) {
+    return (uint64_t)source_network << 32 | destination_network;
+}
+
+int acl_rule_matches_ports(const acl_rule_t* rule, const flow_t* flow) {
+    return flow->source_port >= rule->min_source_port && flow->source_port <= rule->max_source_port
+        && flow->destination_port >= rule->min_destination_port && flow->destination_port <= rule->max_destination_port
+        && (rule->protocol == 0 || rule->protocol == flow->protocol);
+}
+
+int compare_acl_tuples(const void* a, const void* b) {
+    return ((const acl_tuple_t*)a)->best_rule - ((const acl_tuple_t*)b)->best_rule;
+}
+
+/**
+ * @brief Compile an access control list into a classifier, the rules must outlive the classifier
+ */
+acl_classifier_t acl_compile(const acl_rule_t rules[], size_t num_rules) {
+    uint64_t probe_start = PROBE_IS_ENABLED(acl_compile) ? now_nanoseconds() : 0;
+    acl_classifier_t classifier = {rules, num_rules, malloc(num_rules * sizeof(int32_t)), NULL, 0};
+    int tuple_index[33][33];
+    size_t tuple_sizes[33 * 33] = {0};
+    memset(tuple_index, -1, sizeof(tuple_index));
+    classifier.tuples = malloc(33 * 33 * sizeof(acl_tuple_t));
+    for (size_t i = 0; i < num_rules; i++){
+        int* index = &tuple_index[rules[i].source.prefixlen][rules[i].destination.prefixlen];
+        if (*index < 0) {
+            *index = classifier.num_tuples++;
+            classifier.tuples[*index] = (acl_tuple_t) {
+                .source_prefixlen = rules[i].source.prefixlen, .destination_prefixlen = rules[i].destination.prefixlen,
+                .source_mask = prefix_table[rules[i].source.prefixlen].subnet_mask,
+                .destination_mask = prefix_table[rules[i].destination.prefixlen].subnet_mask,
+                .best_rule = i
+            };
+        }
+        tuple_sizes[*index]++;
+    }
+    for (size_t t = 0; t < classifier.num_tuples; t++){
+        acl_tuple_t* tuple = &classifier.tuples[t];
+        tuple->capacity = 1;
+        while (tuple->capacity < 2 * tuple_sizes[t]) {
+            tuple->capacity *= 2;
+        }
+        tuple->keys = malloc(tuple->capacity * sizeof(uint64_t));
+        tuple->heads = malloc(tuple->capacity * sizeof(int32_t));
+        memset(tuple->heads, -1, tuple->capacity * sizeof(int32_t));
+    }
+    //rules are inserted at the head of their chain in reverse order, so that chains are in order of priority
+    for (size_t i = num_rules; i-- > 0;){
+        acl_tuple_t* tuple = &classifier.tuples[tuple_index[rules[i].source.prefixlen][rules[i].destination.prefixlen]];
+        uint64_t key = acl_key(rules[i].source.network_address & tuple->source_mask, rules[i].destination.network_address & tuple->destination_mask);
+        size_t slot = hash_u64(key) & (tuple->capacity - 1);
+        while (tuple->heads[slot] >= 0 && tuple->keys[slot] != key) {
+            slot = (slot + 1) & (tuple->capacity - 1);
+        }
+        classifier.next_rule[i] = tuple->heads[slot];
+        tuple->keys[slot] = key;
+        tuple->heads[slot] = i;
+    }
+    qsort(classifier.tuples, classifier.num_tuples, sizeof(acl_tuple_t), compare_acl_tuples);
+    PROBE3(acl_compile, num_rules, classifier.num_tuples, probe_start != 0 ? now_nanoseconds() - probe_start : 0);
+    return classifier;
+}
+
+void acl_classifier_destroy(acl_classifier_t* classifier) {
+    for (size_t t = 0; t < classifier->num_tuples; t++){
+        free(classifier->tuples[t].keys);
+        free(classifier->tuples[t].heads);
+    }
+    free(classifier->tuples);
+    free(classifier->next_rule);
+}
+
+/**
+ * @brief Find the first rule of the access control list that matches the flow
+ * 
+ * @return int32_t index of the rule, -1 if no rule matches
+ */
+int32_t acl_classify(const acl_classifier_t* classifier, const flow_t* flow) {
+    INSTRUMENT_BEGIN(OP_ACL_CLASSIFY);
+    int32_t best_rule = INT32_MAX;
+    for (size_t t = 0; t < classifier->num_tuples && classifier->tuples[t].best_rule < best_rule; t++){
+        const acl_tuple_t* tuple = &classifier->tuples[t];
+        uint64_t key = acl_key(flow->source_address & tuple->source_mask, flow->destination_address & tuple->destination_mask);
+        size_t slot = hash_u64(key) & (tuple->capacity - 1);
+        while (tuple->heads[slot] >= 0 && tuple->keys[slot] != key) {
+            slot = (slot + 1) & (tuple->capacity - 1);
+        }
+        for (int32_t rule = tuple->heads[slot]; rule >= 0 && rule < best_rule; rule = classifier->next_rule[rule]){
+            if (acl_rule_matches_ports(&classifier->rules[rule], flow)) {
+                best_rule = rule;
+                break;
+            }
+        }
+    }
+    INSTRUMENT_END(OP_ACL_CLASSIFY);
+    return best_rule == INT32_MAX ? -1 : best_rule;
+}
+
+/**
+ * @brief Action of the first rule of the access control list that matches the flow
+ * 
+ * @return int ACL_PERMIT or ACL_DENY, 'default_action' if no rule matches
+ */
+int acl_action(const acl_classifier_t* classifier, const flow_t* flow, int default_action) {
+    int32_t rule = acl_classify(classifier, flow);
+    return rule < 0 ? default_action : classifier->rules[rule].action;
+}
+
+void acl_classify_batch(const acl_classifier_t* classifier, const flow_t flows[], size_t num_flows, int32_t results[]) {
+    for (size_t i = 0; i < num_flows; i++){
+        results[i] = acl_classify(classifier, &flows[i]);
+    }
+}
+
+/**
+ * @brief Reference classification scanning the rules in order
+ */
+int32_t acl_classify_linear(const acl_rule_t rules[], size_t num_rules, const flow_t* flow) {
+    for (size_t i = 0; i < num_rules; i++){
+        uint32_t source_mask = prefix_table[rules[i].source.prefixlen].subnet_mask;
+        uint32_t destination_mask = prefix_table[rules[i].destination.prefixlen].subnet_mask;
+        if (((flow->source_address ^ rules[i].source.network_address) & source_mask) == 0
+            && ((flow->destination_address ^ rules[i].destination.network_address) & destination_mask) == 0
+            && acl_rule_matches_ports(&rules[i], flow)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Classifications per second of random flows against access control lists of 10K and 100K rules
+ */
+void acl_benchmark() {
+    const int prefixlens[] = {0, 8, 16, 20, 24, 28, 32};
+    size_t num_flows = 1000000;
+    flow_t* flows = malloc(num_flows * sizeof(flow_t));
+    int32_t* results = malloc(num_flows * sizeof(int32_t));
+    uint64_t seed = 31;
+
+    for (size_t num_rules = 10000; num_rules <= 100000; num_rules *= 10){
+        acl_rule_t* rules = malloc(num_rules * sizeof(acl_rule_t));
+        for (size_t i = 0; i < num_rules; i++){
+            uint64_t r = splitmix64(&seed);
+            uint16_t port = 1 + (r >> 48) % 1024;
+            rules[i] = (acl_rule_t) {
+                .source = subnet_calculator(0x0A000000 | (r & 0xFFFFFF), prefixlens[1 + (r >> 24) % 6]),
+                .destination = subnet_calculator(0xAC100000 | (r >> 28 & 0xFFFFF), prefixlens[2 + (r >> 40) % 5]),
+                .min_source_port = 0, .max_source_port = 65535,
+                .min_destination_port = r >> 44 & 1 ? port : 0, .max_destination_port = r >> 44 & 1 ? port + (r >> 45 & 7) : 65535,
+                .protocol = r >> 47 & 1 ? 6 : 0,
+                .action = i % 2 ? ACL_PERMIT : ACL_DENY
+            };
+        }
+        //a catch-all rule at the end
+        rules[num_rules - 1].source = subnet_calculator(0, 0);
+        rules[num_rules - 1].destination = subnet_calculator(0, 0);
+
+        //half of the flows are derived from the rules so that they match some of them
+        for (size_t i = 0; i < num_flows; i++){
+            uint64_t r = splitmix64(&seed);
+            const acl_rule_t* rule = &rules[r % num_rules];
+            flows[i] = (flow_t) {
+                .source_address = i % 2 ? rule->source.network_address | (uint32_t)(r >> 32 & ~rule->source.subnet_mask) : (uint32_t)(r >> 32),
+                .destination_address = i % 2 ? rule->destination.network_address | (uint32_t)(r & ~rule->destination.subnet_mask) : 0xAC100000 | (uint32_t)(r & 0xFFFFF),
+                .source_port = 1024 + (r >> 20 & 0x7FFF),
+                .destination_port = rule->min_destination_port,
+                .protocol = r >> 40 & 1 ? 6 : 17
+            };
+        }
+
+        double start = now_seconds();
+        acl_classifier_t classifier = acl_compile(rules, num_rules);
+        double compile_time = now_seconds() - start;
+        start = now_seconds();
+        acl_classify_batch(&classifier, flows, num_flows, results);
+        double elapsed = now_seconds() - start;
+        size_t num_permitted = 0;
+        for (size_t i = 0; i < num_flows; i++){
+            num_permitted += (results[i] < 0 ? ACL_DENY : rules[results[i]].action) == ACL_PERMIT;
+        }
+        printf("%zu rules in %zu tuples compiled in %.1f ms: %.2f M classifications/s, %.1f%% permitted\n", num_rules,
+            classifier.num_tuples, compile_time * 1e3, num_flows / elapsed / 1e6, 100.0 * num_permitted / num_flows);
+
+        //sanity check against the linear scan of the rules
+        for (size_t i = 0; i < 1000; i++){
+            assert(results[i] == acl_classify_linear(rules, num_rules, &flows[i]));
+            assert(acl_action(&classifier, &flows[i], ACL_DENY) == (results[i] < 0 ? ACL_DENY : rules[results[i]].action));
+        }
+        acl_classifier_destroy(&classifier);
+        free(rules);
+    }
+
+    free(results);
+    free(flows);
+}
+
+/*
+ * Static plan of the management network, calculated at compile time in the same way as 'vlsm': subnets are allocated
+ * one after the other in descending order of size, each one sized for its number of hosts.
+ */
+#define MANAGEMENT_POOL_ADDRESS IPV4(10, 255, 0, 0)
+#define MANAGEMENT_POOL_PREFIXLEN 20
+
+#define OOB_PREFIXLEN SUBNET_PREFIXLEN_FOR_HOSTS(1000)
+#define OOB_ADDRESS MANAGEMENT_POOL_ADDRESS
+#define BMC_PREFIXLEN SUBNET_PREFIXLEN_FOR_HOSTS(500)
+#define BMC_ADDRESS SUBNET_NEXT_NETWORK(OOB_ADDRESS, OOB_PREFIXLEN)
+#define SWITCHES_PREFIXLEN SUBNET_PREFIXLEN_FOR_HOSTS(100)
+#define SWITCHES_ADDRESS SUBNET_NEXT_NETWORK(BMC_ADDRESS, BMC_PREFIXLEN)
+#define VPN_PREFIXLEN SUBNET_PREFIXLEN_FOR_HOSTS(20)
+#define VPN_ADDRESS SUBNET_NEXT_NETWORK(SWITCHES_ADDRESS, SWITCHES_PREFIXLEN)
+
+STATIC_ASSERT_SUBNET_IN_POOL(MANAGEMENT_POOL_ADDRESS, MANAGEMENT_POOL_PREFIXLEN, OOB_ADDRESS, OOB_PREFIXLEN);
+STATIC_ASSERT_SUBNET_IN_POOL(MANAGEMENT_POOL_ADDRESS, MANAGEMENT_POOL_PREFIXLEN, BMC_ADDRESS, BMC_PREFIXLEN);
+STATIC_ASSERT_SUBNET_IN_POOL(MANAGEMENT_POOL_ADDRESS, MANAGEMENT_POOL_PREFIXLEN, SWITCHES_ADDRESS, SWITCHES_PREFIXLEN);
+STATIC_ASSERT_SUBNET_IN_POOL(MANAGEMENT_POOL_ADDRESS, MANAGEMENT_POOL_PREFIXLEN, VPN_ADDRESS, VPN_PREFIXLEN);
+
+const subnet_t management_plan[] = {
+    SUBNET(OOB_ADDRESS, OOB_PREFIXLEN),
+    SUBNET(BMC_ADDRESS, BMC_PREFIXLEN),
+    SUBNET(SWITCHES_ADDRESS, SWITCHES_PREFIXLEN),
+    SUBNET(VPN_ADDRESS, VPN_PREFIXLEN)
+};
+
+void static_plan_test_cases() {
+    subnet_t original_subnet = subnet_calculator(MANAGEMENT_POOL_ADDRESS, MANAGEMENT_POOL_PREFIXLEN);
+    subnet_t target_subnets[] = {{.num_ip_addresses=1000}, {.num_ip_addresses=500}, {.num_ip_addresses=100}, {.num_ip_addresses=20}};
+    size_t num_subnets = 4;
+    vlsm(&original_subnet, target_subnets, num_subnets);
+    for (size_t i = 0; i < num_subnets; i++){
+        //the plan calculated at compile time is the same as the one calculated by 'vlsm'
+        assert(memcmp(&management_plan[i], &target_subnets[i], sizeof(subnet_t)) == 0);
+        printf("\n");
+        print_subnet_params(management_plan[i]);
+    }
+}
+
+void prefix_table_test_cases() {
+    for (int prefixlen = 0; prefixlen <= 32; prefixlen++){
+        const prefix_params_t* prefix_params = &prefix_table[prefixlen];
+        assert(__builtin_popcount(prefix_params->subnet_mask) == prefixlen);
+        assert(prefix_params->host_mask == ~prefix_params->subnet_mask);
+        assert(prefix_params->num_ip_addresses == (uint64_t)prefix_params->host_mask + 1);
+
+        subnet_t subnet = subnet_calculator(to_int((ip_address_t) {172, 31, 200, 77}), prefixlen);
+        assert((subnet.network_address & prefix_params->host_mask) == 0);
+        assert(subnet.broadcast_address == (subnet.network_address | prefix_params->host_mask));
+        assert(subnet.subnet_mask == prefix_params->subnet_mask);
+        assert(subnet.num_ip_addresses == (uint32_t)prefix_params->num_ip_addresses);
+        assert(subnet.prefixlen == prefixlen);
+        //50 addresses need 6 bits
+        assert(calculate_num_subnets(prefixlen, 50) == (prefixlen > 26 ? 0 : (uint64_t)1 << (26 - prefixlen)));
+    }
+    assert(calculate_num_subnets(0, 1) == (uint64_t)1 << 31);
+    printf("prefix table: /0 to /32 ok\n");
+}
+
+/**
+ * @brief Throughput of 'subnet_calculator' over all the prefix lengths compared with computing the masks with variable shifts
+ */
+void subnet_calculator_benchmark() {
+    size_t num_iterations = 100000000;
+    uint64_t seed = 33;
+    uint32_t ip_address = splitmix64(&seed);
+    uint64_t checksum = 0;
+
+    double start = now_seconds();
+    for (size_t i = 0; i < num_iterations; i++){
+        subnet_t subnet = subnet_calculator(ip_address + i, 1 + i % 31);
+        checksum += subnet.network_address ^ subnet.broadcast_address ^ subnet.subnet_mask;
+    }
+    double elapsed_table = now_seconds() - start;
+
+    start = now_seconds();
+    for (size_t i = 0; i < num_iterations; i++){
+        //prefix lengths /1 to /31, shifting by 32 is undefined
+        int prefixlen = 1 + i % 31;
+        uint32_t network_address = (ip_address + i) & (0xFFFFFFFF << (32 - prefixlen));
+        uint32_t broadcast_address = (ip_address + i) | (0xFFFFFFFF >> prefixlen);
+        checksum -= network_address ^ broadcast_address ^ (0xFFFFFFFF << (32 - prefixlen));
+    }
+    double elapsed_shift = now_seconds() - start;
+
+    printf("subnet_calculator with prefix table: %.2f ns/op, with shifts: %.2f ns/op (checksum %" PRIu64 ")\n",
+        elapsed_table / num_iterations * 1e9, elapsed_shift / num_iterations * 1e9, checksum);
+}
+
+/**
+ * @brief data structure to represent a subnet in 8 bytes instead of the 32 bytes of subnet_t
+ * 
+ * Only the network address and the prefix length are stored, the rest of parameters are derived on demand
+ * with the functions compact_*
+ */
+typedef struct {
+    uint32_t network_address;
+    uint8_t prefixlen;
+} compact_subnet_t;
+
+compact_subnet_t compact_subnet_calculator(uint32_t ip_address, int cidr_prefix) {
+    return (compact_subnet_t) {ip_address & prefix_table[cidr_prefix].subnet_mask, cidr_prefix};
+}
+
+uint32_t compact_subnet_mask(compact_subnet_t subnet) {
+    return prefix_table[subnet.prefixlen].subnet_mask;
+}
+
+uint32_t compact_broadcast_address(compact_subnet_t subnet) {
+    return subnet.network_address | prefix_table[subnet.prefixlen].host_mask;
+}
+
+uint32_t compact_first_address(compact_subnet_t subnet) {
+    return subnet.network_address + 1;
+}
+
+uint32_t compact_last_address(compact_subnet_t subnet) {
+    return compact_broadcast_address(subnet) - 1;
+}
+
+uint32_t compact_next_network(compact_subnet_t subnet) {
+    return compact_broadcast_address(subnet) + 1;
+}
+
+uint32_t compact_num_ip_addresses(compact_subnet_t subnet) {
+    return prefix_table[subnet.prefixlen].num_ip_addresses;
+}
+
+compact_subnet_t to_compact_subnet(subnet_t subnet) {
+    return (compact_subnet_t) {subnet.network_address, subnet.prefixlen};
+}
+
+subnet_t from_compact_subnet(compact_subnet_t subnet) {
+    return subnet_calculator(subnet.network_address, subnet.prefixlen);
+}
+
+void print_compact_subnet_params(compact_subnet_t subnet) {
+    print_subnet_params(from_compact_subnet(subnet));
+}
+
+int compare_compact_func(const void* a, const void* b) {
+    return ((compact_subnet_t*)a)->prefixlen - ((compact_subnet_t*)b)->prefixlen;
+}
+
+/**
+ * @brief Calculate Variable-Length Subnet Masks, compact version of 'vlsm'
+ * 
+ * The minimum number of hosts of each subnet is given by 'num_ip_addresses'. The subnets are returned in 'subnets'
+ * sorted according to their size in descending order.
+ * 
+ * @param original_subnet 
+ * @param num_ip_addresses 
+ * @param subnets out parameter
+ * @param num_subnets 
+ * @return compact_subnet_t* For convenience, the parameter 'subnets` is also returned
+ */
+compact_subnet_t* vlsm_compact(compact_subnet_t original_subnet, const int num_ip_addresses[], compact_subnet_t subnets[], size_t num_subnets) {
+    uint64_t total_num_ip_address_required = 0;
+    for (size_t i = 0; i < num_subnets; i++){
+        subnets[i].prefixlen = calculate_subnet_prefixlen(num_ip_addresses[i]);
+        total_num_ip_address_required += prefix_table[subnets[i].prefixlen].num_ip_addresses;
+    }
+    //sanity check
+    assert(total_num_ip_address_required <= prefix_table[original_subnet.prefixlen].num_ip_addresses);
+
+    qsort(subnets, num_subnets, sizeof(compact_subnet_t), compare_compact_func);
+
+    uint32_t next_network = original_subnet.network_address;
+    for (size_t i = 0; i < num_subnets; i++){
+        subnets[i] = compact_subnet_calculator(next_network, subnets[i].prefixlen);
+        next_network = compact_next_network(subnets[i]);
+    }
+    return subnets;
+}
+
+/**
+ * @brief Memory and throughput of 10M subnets stored as subnet_t compared with compact_subnet_t
+ */
+void compact_subnet_benchmark() {
+    size_t num_subnets = 10000000;
+    subnet_t* subnets = malloc(num_subnets * sizeof(subnet_t));
+    compact_subnet_t* compact_subnets = malloc(num_subnets * sizeof(compact_subnet_t));
+    uint32_t* ip_addresses = malloc(num_subnets * sizeof(uint32_t));
+    uint8_t* prefixlens = malloc(num_subnets);
+    uint64_t seed = 34;
+    for (size_t i = 0; i < num_subnets; i++){
+        uint64_t r = splitmix64(&seed);
+        ip_addresses[i] = r;
+        prefixlens[i] = 8 + (r >> 32) % 25;
+    }
+
+    //both representations are built from the same raw (address, prefix length) input
+    double start = now_seconds();
+    for (size_t i = 0; i < num_subnets; i++){
+        subnets[i] = subnet_calculator(ip_addresses[i], prefixlens[i]);
+    }
+    double build_time = now_seconds() - start;
+    start = now_seconds();
+    for (size_t i = 0; i < num_subnets; i++){
+        compact_subnets[i] = compact_subnet_calculator(ip_addresses[i], prefixlens[i]);
+    }
+    double compact_build_time = now_seconds() - start;
+
+    uint64_t checksum = 0, compact_checksum = 0;
+    start = now_seconds();
+    for (size_t i = 0; i < num_subnets; i++){
+        checksum += subnets[i].broadcast_address + subnets[i].num_ip_addresses;
+    }
+    double scan_time = now_seconds() - start;
+    start = now_seconds();
+    for (size_t i = 0; i < num_subnets; i++){
+        compact_checksum += compact_broadcast_address(compact_subnets[i]) + compact_num_ip_addresses(compact_subnets[i]);
+    }
+    double compact_scan_time = now_seconds() - start;
+    assert(checksum == compact_checksum);
+
+    printf("subnet_t:         %zu bytes each, %.1f MB, build %.1f ms, scan %.1f ms\n", sizeof(subnet_t),
+        num_subnets * sizeof(subnet_t) / 1e6, build_time * 1e3, scan_time * 1e3);
+    printf("compact_subnet_t: %zu bytes each, %.1f MB, build %.1f ms, scan %.1f ms\n", sizeof(compact_subnet_t),
+        num_subnets * sizeof(compact_subnet_t) / 1e6, compact_build_time * 1e3, compact_scan_time * 1e3);
+
+    free(prefixlens);
+    free(ip_addresses);
+    free(compact_subnets);
+    free(subnets);
+}
+
+#define NUM_PERF_COUNTERS 4
+
+const char* perf_counter_names[NUM_PERF_COUNTERS] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+
+/**
+ * @brief data structure to read hardware counters of the current thread with perf_event_open (Linux only)
+ * 
+ * Counters that cannot be opened (other systems, containers without permission...) have a file descriptor of -1
+ */
+typedef struct {
+    int fds[NUM_PERF_COUNTERS];
+} perf_counters_t;
+
+perf_counters_t perf_counters_open() {
+    perf_counters_t counters;
+#ifdef __linux__
+    const uint64_t configs[NUM_PERF_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++){
+        struct perf_event_attr attr = {.type = PERF_TYPE_HARDWARE, .size = sizeof(attr), .config = configs[i],
+            .disabled = 1, .exclude_kernel = 1, .exclude_hv = 1};
+        counters.fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#else
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++){
+        counters.fds[i] = -1;
+    }
+#endif
+    return counters;
+}
+
+void perf_counters_start(perf_counters_t* counters) {
+#ifdef __linux__
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++){
+        if (counters->fds[i] >= 0) {
+            ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#else
+    (void)counters;
+#endif
+}
+
+/**
+ * @brief Stop the counters and read their values, -1 for the counters not available
+ */
+void perf_counters_stop(perf_counters_t* counters, int64_t values[]) {
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++){
+        values[i] = -1;
+#ifdef __linux__
+        uint64_t value;
+        if (counters->fds[i] >= 0) {
+            ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(counters->fds[i], &value, sizeof(value)) == sizeof(value)) {
+                values[i] = value;
+            }
+        }
+#endif
+    }
+}
+
+void perf_counters_close(perf_counters_t* counters) {
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++){
+        if (counters->fds[i] >= 0) {
+            close(counters->fds[i]);
+        }
+    }
+}
+
+/**
+ * @brief data structure to represent a benchmark of the suite
+ * 
+ * 'setup' prepares the input of the given size, 'run' processes the whole input once and returns a checksum
+ * so that the compiler cannot discard the work. Each element of the input counts as one operation
+ */
+typedef struct {
+    const char* name;
+    void* (*setup)(size_t size);
+    uint64_t (*run)(void* input, size_t size);
+} benchmark_t;
+
+typedef struct {
+    const char* name;
+    size_t size;
+    uint64_t num_operations;
+    double ns_per_operation;
+    int64_t counters[NUM_PERF_COUNTERS];
+} benchmark_result_t;
+
+void* random_input_setup(size_t size) {
+    uint64_t* input = malloc(size * sizeof(uint64_t));
+    uint64_t seed = size;
+    for (size_t i = 0; i < size; i++){
+        input[i] = splitmix64(&seed);
+    }
+    return input;
+}
+
+uint64_t subnet_calculator_run(void* input, size_t size) {
+    const uint64_t* values = input;
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < size; i++){
+        subnet_t subnet = subnet_calculator(values[i], values[i] >> 32 & 31);
+        checksum += subnet.broadcast_address ^ subnet.num_ip_addresses;
+    }
+    return checksum;
+}
+
+uint64_t dotted_decimal_notation_run(void* input, size_t size) {
+    const uint64_t* values = input;
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < size; i++){
+        checksum += to_int(to_dotted_decimal_notation(values[i])) ^ i;
+    }
+    return checksum;
+}
+
+uint64_t calculate_subnet_size_run(void* input, size_t size) {
+    const uint64_t* values = input;
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < size; i++){
+        checksum += calculate_subnet_size(values[i] % 16, 1 + (values[i] >> 32 & 0xFFFF));
+    }
+    return checksum;
+}
+
+uint64_t calculate_num_subnets_run(void* input, size_t size) {
+    const uint64_t* values = input;
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < size; i++){
+        checksum += calculate_num_subnets(8 + values[i] % 16, 1 + (values[i] >> 32 & 0xFF));
+    }
+    return checksum;
+}
+
+uint64_t calculate_subnet_prefixlen_run(void* input, size_t size) {
+    const uint64_t* values = input;
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < size; i++){
+        checksum += calculate_subnet_prefixlen(values[i] & 0xFFFFFF);
+    }
+    return checksum;
+}
+
+/**
+ * @brief One 'vlsm' of 'size' subnets of up to 254 hosts in 0.0.0.0/0, including copying the requirements
+ */
+uint64_t vlsm_run(void* input, size_t size) {
+    const uint64_t* values = input;
+    subnet_t* subnets = malloc(size * sizeof(subnet_t));
+    for (size_t i = 0; i < size; i++){
+        subnets[i] = (subnet_t) {.num_ip_addresses = 1 + values[i] % 254};
+    }
+    subnet_t original_subnet = subnet_calculator(0, 0);
+    vlsm(&original_subnet, subnets, size);
+    uint64_t checksum = subnets[size - 1].broadcast_address;
+    free(subnets);
+    return checksum;
+}
+
+const benchmark_t benchmarks[] = {
+    {"subnet_calculator", random_input_setup, subnet_calculator_run},
+    {"to_dotted_decimal_notation+to_int", random_input_setup, dotted_decimal_notation_run},
+    {"calculate_subnet_size", random_input_setup, calculate_subnet_size_run},
+    {"calculate_num_subnets", random_input_setup, calculate_num_subnets_run},
+    {"calculate_subnet_prefixlen", random_input_setup, calculate_subnet_prefixlen_run},
+    {"vlsm", random_input_setup, vlsm_run},
+};
+
+const size_t benchmark_sizes[] = {1 << 10, 1 << 16, 1 << 20};
+
+#define BENCHMARK_MIN_SECONDS 0.2
+
+/**
+ * @brief Run a benchmark with an input of the given size as many times as needed to last at least BENCHMARK_MIN_SECONDS
+ */
+benchmark_result_t run_benchmark(const benchmark_t* benchmark, size_t size, perf_counters_t* counters) {
+    benchmark_result_t result = {.name = benchmark->name, .size = size};
+    void* input = benchmark->setup(size);
+    volatile uint64_t checksum = benchmark->run(input, size);
+
+    double elapsed = 0;
+    perf_counters_start(counters);
+    double start = now_seconds();
+    while (elapsed < BENCHMARK_MIN_SECONDS) {
+        checksum += benchmark->run(input, size);
+        result.num_operations += size;
+        elapsed = now_seconds() - start;
+    }
+    perf_counters_stop(counters, result.counters);
+
+    result.ns_per_operation = elapsed / result.num_operations * 1e9;
+    free(input);
+    return result;
+}
+
+void print_benchmark_result_json(FILE* out, const benchmark_result_t* result) {
+    fprintf(out, "{\"name\": \"%s\", \"size\": %zu, \"operations\": %" PRIu64 ", \"ns_per_op\": %.4f", result->name, result->size,
+        result->num_operations, result->ns_per_operation);
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++){
+        if (result->counters[i] >= 0) {
+            fprintf(out, ", \"%s_per_op\": %.4f", perf_counter_names[i], (double)result->counters[i] / result->num_operations);
+        } else {
+            fprintf(out, ", \"%s_per_op\": null", perf_counter_names[i]);
+        }
+    }
+    fprintf(out, "}");
+}
+
+/**
+ * @brief Run the benchmark suite, printing a summary and writing the results in JSON to 'results_path' if not NULL
+ * 
+ * The results of two runs are compared with 'compare_benchmarks.py' to detect regressions
+ * 
+ * @return int 0 if successful, -1 if the results cannot be written
+ */
+int run_benchmark_suite(const char* results_path) {
+    FILE* results = NULL;
+    if (results_path != NULL && (results = fopen(results_path, "w")) == NULL) {
+        return -1;
+    }
+    perf_counters_t counters = perf_counters_open();
+    if (results != NULL) {
+        fprintf(results, "[\n");
+    }
+    printf("%-36s %10s %12s %14s %14s\n", "benchmark", "size", "ns/op", "cycles/op", "instr/op");
+    const char* separator = "";
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++){
+        for (size_t j = 0; j < sizeof(benchmark_sizes) / sizeof(benchmark_sizes[0]); j++){
+            benchmark_result_t result = run_benchmark(&benchmarks[i], benchmark_sizes[j], &counters);
+            printf("%-36s %10zu %12.3f %14.3f %14.3f\n", result.name, result.size, result.ns_per_operation,
+                result.counters[0] >= 0 ? (double)result.counters[0] / result.num_operations : NAN,
+                result.counters[1] >= 0 ? (double)result.counters[1] / result.num_operations : NAN);
+            if (results != NULL) {
+                fprintf(results, "%s  ", separator);
+                print_benchmark_result_json(results, &result);
+                separator = ",\n";
+            }
+        }
+    }
+    int result = 0;
+    if (results != NULL) {
+        fprintf(results, "\n]\n");
+        int write_error = ferror(results);
+        if (fclose(results) != 0 || write_error) {
+            result = -1;
+        }
+    }
+    perf_counters_close(&counters);
+    return result;
+}
+
+typedef enum {
+    WORKLOAD_PREFIXES,
+    WORKLOAD_LOGS,
+    WORKLOAD_VLSM,
+    WORKLOAD_RANGES
+} workload_kind_t;
+
+const char* workload_names[] = {"prefixes", "logs", "vlsm", "ranges"};
+
+/**
+ * @brief Prefix length distribution similar to the one of the Internet routing table, in percentage from /8 to /24
+ */
+const int routing_table_prefixlen_distribution[17] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 3, 5, 6, 10, 10, 62};
+
+/**
+ * @brief Prefix of the unicast space, first byte from 1 to 223, with a length following 'routing_table_prefixlen_distribution'
+ * 
+ * @param r random bits, e.g. from splitmix64
+ */
+compact_subnet_t random_routing_prefix(uint64_t r) {
+    int percentile = r % 100, prefixlen = 8;
+    while (percentile >= routing_table_prefixlen_distribution[prefixlen - 8]) {
+        percentile -= routing_table_prefixlen_distribution[prefixlen - 8];
+        prefixlen++;
+    }
+    return compact_subnet_calculator((uint32_t)(1 + (r >> 32) % 223) << 24 | (uint32_t)(r >> 8 & 0xFFFFFF), prefixlen);
+}
+
+#define WORKLOAD_CHUNK_SIZE 65536
+#define ZIPF_UNIVERSE_SIZE (1 << 20)
+#define ZIPF_EXPONENT 1.1
+
+/**
+ * @brief Sample a rank in [0, ZIPF_UNIVERSE_SIZE) following (approximately) a Zipf distribution, using the inverse of its continuous CDF
+ */
+uint32_t zipf_rank(uint64_t* seed) {
+    double u = (splitmix64(seed) >> 11) * 0x1.0p-53;
+    double exponent = 1 - ZIPF_EXPONENT;
+    double rank = pow((pow(ZIPF_UNIVERSE_SIZE + 1.0, exponent) - 1) * u + 1, 1 / exponent) - 1;
+    return rank < ZIPF_UNIVERSE_SIZE ? (uint32_t)rank : ZIPF_UNIVERSE_SIZE - 1;
+}
+
+uint32_t to_little_endian(uint32_t value) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return __builtin_bswap32(value);
+#else
+    return value;
+#endif
+}
+
+//byte swaps are their own inverse, so these also convert the little-endian values read from files
+uint64_t to_little_endian64(uint64_t value) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return __builtin_bswap64(value);
+#else
+    return value;
+#endif
+}
+
+/**
+ * @brief Append a uint32_t to a binary record in little-endian byte order
+ */
+char* put_u32(char* end, uint32_t value) {
+    value = to_little_endian(value);
+    memcpy(end, &value, sizeof(value));
+    return end + sizeof(value);
+}
+
+/**
+ * @brief Generate records [first, first + count) of a workload, appending them to 'out'
+ * 
+ * Each chunk of WORKLOAD_CHUNK_SIZE records has its own seed, so the output only depends on the seed and not on
+ * the number of threads used to generate it.
+ * 
+ * Record formats, text | binary (integers are little-endian):
+ * - prefixes: "a.b.c.d/n" | uint32_t network address, uint8_t prefix length
+ * - logs: access log line with a Zipfian client ip address | uint32_t ip address
+ * - vlsm: "a.b.c.d/n h1 h2 ... hn", a pool and the number of hosts of each subnet, which always fit in the pool |
+ *   uint32_t network address, uint8_t prefix length, uint32_t n, n x uint32_t
+ * - ranges: "a.b.c.d-e.f.g.h" | 2 x uint32_t
+ */
+void generate_workload_chunk(workload_kind_t kind, int binary, uint64_t seed, uint64_t chunk, size_t count, text_buffer_t* out) {
+    uint64_t state = seed ^ hash_u64(chunk + 1);
+    char line[256];
+    for (size_t i = 0; i < count; i++){
+        uint64_t r = splitmix64(&state);
+        char* end = line;
+        switch (kind) {
+            case WORKLOAD_PREFIXES: {
+                compact_subnet_t subnet = random_routing_prefix(r);
+                if (binary) {
+                    end = put_u32(end, subnet.network_address);
+                    *end++ = subnet.prefixlen;
+                } else {
+                    end += format_ip_address(end, subnet.network_address);
+                    *end++ = '/';
+                    end += format_decimal(end, subnet.prefixlen);
+                    *end++ = '\n';
+                }
+                break;
+            }
+            case WORKLOAD_LOGS: {
+                //the most popular ip addresses are scattered over the address space with a bijective hash of the rank
+                uint32_t ip_address = (zipf_rank(&state) ^ (uint32_t)seed) * 0x9E3779B1u + 0x7F4A7C15u;
+                if (binary) {
+                    end = put_u32(end, ip_address);
+                } else {
+                    static const char request[] = " - - [16/Oct/2026:10:00:00 +0000] \"GET /api/v1/items/";
+                    static const char protocol[] = " HTTP/1.1\" ";
+                    end += format_ip_address(end, ip_address);
+                    memcpy(end, request, sizeof(request) - 1);
+                    //minutes and seconds of the timestamp
+                    end[21] = '0' + r % 6;
+                    end[22] = '0' + (r >> 8) % 10;
+                    end[24] = '0' + (r >> 16) % 6;
+                    end[25] = '0' + (r >> 24) % 10;
+                    end += sizeof(request) - 1;
+                    end += format_decimal(end, r >> 32 & 0xFFFF);
+                    memcpy(end, protocol, sizeof(protocol) - 1);
+                    end += sizeof(protocol) - 1;
+                    memcpy(end, r >> 48 & 15 ? "200 " : "404 ", 4);
+                    end += 4;
+                    end += format_decimal(end, r >> 52);
+                    *end++ = '\n';
+                }
+                break;
+            }
+            case WORKLOAD_VLSM: {
+                compact_subnet_t pool = compact_subnet_calculator(0x0A000000 | (uint32_t)(r & 0xFFFF) << 8, 16 + (r >> 16) % 5);
+                uint32_t num_subnets = 1 + (r >> 24) % 8;
+                //each subnet fits in an equal share of the pool, so that the plan is always feasible
+                uint32_t share = prefix_table[pool.prefixlen].num_ip_addresses / num_subnets;
+                uint32_t max_hosts = (1u << (31 - __builtin_clz(share))) - 2;
+                if (binary) {
+                    end = put_u32(end, pool.network_address);
+                    *end++ = pool.prefixlen;
+                    end = put_u32(end, num_subnets);
+                } else {
+                    end += format_ip_address(end, pool.network_address);
+                    *end++ = '/';
+                    end += format_decimal(end, pool.prefixlen);
+                }
+                for (uint32_t j = 0; j < num_subnets; j++){
+                    //mostly small subnets: the number of hosts is log-uniformly distributed, its number of bits being uniform
+                    uint32_t num_hosts = 2 + (splitmix64(&state) & ((1u << (2 + (r >> (32 + 2 * j)) % 9)) - 1));
+                    if (num_hosts > max_hosts) {
+                        num_hosts = max_hosts;
+                    }
+                    if (binary) {
+                        end = put_u32(end, num_hosts);
+                    } else {
+                        *end++ = ' ';
+                        end += format_decimal(end, num_hosts);
+                    }
+                }
+                if (!binary) {
+                    *end++ = '\n';
+                }
+                break;
+            }
+            case WORKLOAD_RANGES: {
+                uint32_t range[2] = {r, 0};
+                range[1] = range[0] + (uint32_t)(r >> 32 & ((1u << (r >> 59)) - 1));
+                if (range[1] < range[0]) {
+                    range[1] = 0xFFFFFFFF;
+                }
+                if (binary) {
+                    end = put_u32(end, range[0]);
+                    end = put_u32(end, range[1]);
+                } else {
+                    end += format_ip_address(end, range[0]);
+                    *end++ = '-';
+                    end += format_ip_address(end, range[1]);
+                    *end++ = '\n';
+                }
+                break;
+            }
+        }
+        text_buffer_append(out, line, end - line);
+    }
+}
+
+typedef struct {
+    workload_kind_t kind;
+    int binary;
+    uint64_t seed;
+    uint64_t first_chunk;
+    size_t count;
+    text_buffer_t output;
+} workload_worker_args_t;
+
+void workload_worker(void* context, size_t begin, size_t end) {
+    workload_worker_args_t* chunks = context;
+    for (size_t i = begin; i < end; i++){
+        chunks[i].output.length = 0;
+        if (chunks[i].count > 0) {
+            generate_workload_chunk(chunks[i].kind, chunks[i].binary, chunks[i].seed, chunks[i].first_chunk, chunks[i].count, &chunks[i].output);
+        }
+    }
+}
+
+#define WORKLOAD_CHUNKS_PER_WORKER 4
+
+/**
+ * @brief Generate 'count' records of a workload and write them to 'out', generating a few chunks per worker of 'pool' in parallel
+ * 
+ * @return int64_t number of bytes written, -1 if the output cannot be written
+ */
+int64_t generate_workload(workload_kind_t kind, int binary, uint64_t seed, uint64_t count, FILE* out, thread_pool_t* pool) {
+    int num_slots = WORKLOAD_CHUNKS_PER_WORKER * thread_pool_num_workers(pool);
+    workload_worker_args_t args[num_slots];
+    memset(args, 0, sizeof(args));
+    uint64_t num_chunks = (count + WORKLOAD_CHUNK_SIZE - 1) / WORKLOAD_CHUNK_SIZE;
+    int64_t num_bytes = 0;
+    for (uint64_t chunk = 0; chunk < num_chunks && num_bytes >= 0; chunk += num_slots){
+        for (int i = 0; i < num_slots; i++){
+            uint64_t first = (chunk + i) * WORKLOAD_CHUNK_SIZE;
+            args[i].kind = kind;
+            args[i].binary = binary;
+            args[i].seed = seed;
+            args[i].first_chunk = chunk + i;
+            args[i].count = first >= count ? 0 : (count - first < WORKLOAD_CHUNK_SIZE ? count - first : WORKLOAD_CHUNK_SIZE);
+        }
+        parallel_for(pool, 0, num_slots, 1, workload_worker, args);
+        for (int i = 0; i < num_slots && num_bytes >= 0; i++){
+            if (fwrite(args[i].output.data, 1, args[i].output.length, out) != args[i].output.length) {
+                num_bytes = -1;
+            } else {
+                num_bytes += args[i].output.length;
+            }
+        }
+    }
+    if (fflush(out) != 0) {
+        num_bytes = -1;
+    }
+    for (int i = 0; i < num_slots; i++){
+        free(args[i].output.data);
+    }
+    return num_bytes;
+}
+
+/**
+ * @brief Parse a decimal number made only of digits
+ * 
+ * @return int 0 if successful, -1 if 'text' is empty, contains other characters or does not fit in 64 bits
+ */
+int parse_uint64(const char* text, uint64_t* value) {
+    if (*text < '0' || *text > '9') {
+        return -1;
+    }
+    char* end;
+    errno = 0;
+    unsigned long long parsed = strtoull(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE) {
+        return -1;
+    }
+    *value = parsed;
+    return 0;
+}
+
+/**
+ * @brief Generation speed of each workload, in text and binary, written to /dev/null
+ */
+void workload_benchmark() {
+    FILE* out = fopen("/dev/null", "w");
+    thread_pool_t* pool = default_thread_pool();
+    int num_threads = thread_pool_num_workers(pool);
+    for (int kind = WORKLOAD_PREFIXES; kind <= WORKLOAD_RANGES; kind++){
+        for (int binary = 0; binary <= 1; binary++){
+            uint64_t count = 10000000;
+            double start = now_seconds();
+            int64_t bytes = generate_workload(kind, binary, 37, count, out, pool);
+            double elapsed = now_seconds() - start;
+            printf("%-8s %-6s: %.1f M records/s, %.2f GB/s using %d threads\n", workload_names[kind], binary ? "binary" : "text",
+                count / elapsed / 1e6, bytes / elapsed / 1e9, num_threads);
+        }
+    }
+    fclose(out);
+}
+
+/**
+ * @brief Overhead of the instrumentation: compare the output of this benchmark built with and without -DINSTRUMENTATION
+ */
+void instrumentation_benchmark() {
+    size_t num_iterations = 100000000;
+    uint64_t checksum = 0;
+    double start = now_seconds();
+    for (size_t i = 0; i < num_iterations; i++){
+        checksum += subnet_calculator(i * 2654435761u, 1 + i % 31).broadcast_address;
+    }
+    double elapsed = now_seconds() - start;
+#ifdef INSTRUMENTATION
+    printf("instrumented subnet_calculator: %.2f ns/op (checksum %" PRIu64 ")\n", elapsed / num_iterations * 1e9, checksum);
+    print_op_stats();
+#else
+    printf("subnet_calculator without instrumentation: %.2f ns/op (checksum %" PRIu64 ")\n", elapsed / num_iterations * 1e9, checksum);
+#endif
+}
+
+/**
+ * @brief Cost of 'vlsm' with its probes: run it as is, attached to bpftrace (probes.bt) and built with -DNO_USDT
+ */
+void probes_benchmark() {
+    size_t num_subnets = 1024, num_iterations = 20000;
+    subnet_t* subnets = malloc(num_subnets * sizeof(subnet_t));
+    subnet_t original_subnet = subnet_calculator(0x0A000000, 8);
+    uint64_t checksum = 0;
+    double start = now_seconds();
+    for (size_t i = 0; i < num_iterations; i++){
+        for (size_t j = 0; j < num_subnets; j++){
+            subnets[j] = (subnet_t) {.num_ip_addresses = 1 + (i + j) % 254};
+        }
+        checksum += vlsm(&original_subnet, subnets, num_subnets)[num_subnets - 1].broadcast_address;
+    }
+    double elapsed = now_seconds() - start;
+#ifdef USDT_PROBES
+    const char* probes = PROBE_IS_ENABLED(vlsm_return) ? "probes enabled" : "probes disabled";
+#else
+    const char* probes = "without probes";
+#endif
+    printf("vlsm of %zu subnets, %s: %.2f us/call (checksum %" PRIu64 ")\n", num_subnets, probes, elapsed / num_iterations * 1e6, checksum);
+    free(subnets);
+}
+
+/*
+ * Columnar binary format for bulk results
+ * 
+ * header | block | block | ...
+ * 
+ * Each block contains up to COLUMNAR_BLOCK_RECORDS subnets stored as one array of little-endian uint32_t per field of
+ * subnet_t (network address, broadcast address, first address, last address, next network, subnet mask, number of
+ * addresses, prefix length), each column starting at a multiple of 64 bytes. Uncompressed files are read in place
+ * through mmap, compressed blocks (zstd or LZ4, when built with -DHAVE_ZSTD -lzstd or -DHAVE_LZ4 -llz4) are
+ * decompressed into a buffer provided by the caller. The fields of the headers are little-endian too.
+ */
+#define COLUMNAR_MAGIC "SUBNETC1"
+#define COLUMNAR_VERSION 1
+#define COLUMNAR_NUM_COLUMNS 8
+#define COLUMNAR_BLOCK_RECORDS 65536
+#define COLUMNAR_ALIGNMENT 64
+
+typedef enum {
+    COLUMNAR_UNCOMPRESSED,
+    COLUMNAR_ZSTD,
+    COLUMNAR_LZ4
+} columnar_compression_t;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t compression;
+    uint64_t num_records;
+    uint64_t num_blocks;
+    uint8_t padding[COLUMNAR_ALIGNMENT - 32];
+} columnar_header_t;
+
+/**
+ * @brief header of a block, the columns follow it, each one taking 'column_sizes[i]' bytes rounded up to COLUMNAR_ALIGNMENT
+ */
+typedef struct {
+    uint32_t num_records;
+    uint32_t reserved;
+    uint64_t column_sizes[COLUMNAR_NUM_COLUMNS];
+    uint8_t padding[COLUMNAR_ALIGNMENT - 8 - 8 * COLUMNAR_NUM_COLUMNS % COLUMNAR_ALIGNMENT];
+} columnar_block_header_t;
+
+typedef struct {
+    FILE* file;
+    columnar_compression_t compression;
+    uint64_t num_records;
+    uint64_t num_blocks;
+    uint32_t* column;
+    char* compressed;
+    size_t compressed_capacity;
+    //set by the first failed write or compression, the file is then reported as invalid when it is closed
+    int error;
+} columnar_writer_t;
+
+size_t columnar_align(size_t size) {
+    return (size + COLUMNAR_ALIGNMENT - 1) & ~(size_t)(COLUMNAR_ALIGNMENT - 1);
+}
+
+/**
+ * @brief Create a columnar file
+ * 
+ * @return int 0 if successful, -1 if the file cannot be created or the compression is not available in this build
+ */
+int columnar_writer_open(const char* path, columnar_compression_t compression, columnar_writer_t* writer) {
+#ifndef HAVE_ZSTD
+    if (compression == COLUMNAR_ZSTD) {
+        return -1;
+    }
+#endif
+#ifndef HAVE_LZ4
+    if (compression == COLUMNAR_LZ4) {
+        return -1;
+    }
+#endif
+    *writer = (columnar_writer_t) {.file = fopen(path, "wb"), .compression = compression};
+    if (writer->file == NULL) {
+        return -1;
+    }
+    columnar_header_t header = {.compression = to_little_endian(compression)};
+    writer->error = fwrite(&header, sizeof(header), 1, writer->file) != 1;
+    writer->column = malloc(COLUMNAR_BLOCK_RECORDS * sizeof(uint32_t));
+    return 0;
+}
+
+/**
+ * @brief Compress a column into the buffer of the writer
+ * 
+ * @return int64_t compressed size, -1 if the compression failed
+ */
+int64_t columnar_compress(columnar_writer_t* writer, const uint32_t* column, size_t size) {
+    size_t bound = size;
+#ifdef HAVE_ZSTD
+    if (writer->compression == COLUMNAR_ZSTD) {
+        bound = ZSTD_compressBound(size);
+    }
+#endif
+#ifdef HAVE_LZ4
+    if (writer->compression == COLUMNAR_LZ4) {
+        bound = LZ4_compressBound(size);
+    }
+#endif
+    if (bound > writer->compressed_capacity) {
+        writer->compressed_capacity = bound;
+        writer->compressed = realloc(writer->compressed, bound);
+    }
+#ifdef HAVE_ZSTD
+    if (writer->compression == COLUMNAR_ZSTD) {
+        size_t compressed_size = ZSTD_compress(writer->compressed, bound, column, size, 1);
+        return ZSTD_isError(compressed_size) ? -1 : (int64_t)compressed_size;
+    }
+#endif
+#ifdef HAVE_LZ4
+    if (writer->compression == COLUMNAR_LZ4) {
+        int compressed_size = LZ4_compress_default((const char*)column, writer->compressed, size, bound);
+        return compressed_size > 0 ? compressed_size : -1;
+    }
+#endif
+    (void)column;
+    return -1;
+}
+
+/**
+ * @brief Write one block with up to COLUMNAR_BLOCK_RECORDS subnets
+ * 
+ * @return int 0 if successful, -1 if the block cannot be compressed or written
+ */
+int columnar_write_block(columnar_writer_t* writer, const subnet_t subnets[], size_t num_subnets) {
+    static const char zeros[COLUMNAR_ALIGNMENT] = {0};
+    columnar_block_header_t block_header = {.num_records = to_little_endian(num_subnets)};
+    long block_start = ftell(writer->file);
+    if (block_start < 0 || fwrite(&block_header, sizeof(block_header), 1, writer->file) != 1) {
+        return -1;
+    }
+    //subnet_t is made of 8 fields of 4 bytes, so each column is a strided read of the array
+    const uint32_t* fields = (const uint32_t*)subnets;
+    for (int c = 0; c < COLUMNAR_NUM_COLUMNS; c++){
+        for (size_t i = 0; i < num_subnets; i++){
+            writer->column[i] = to_little_endian(fields[i * COLUMNAR_NUM_COLUMNS + c]);
+        }
+        size_t size = num_subnets * sizeof(uint32_t);
+        const void* data = writer->column;
+        if (writer->compression != COLUMNAR_UNCOMPRESSED) {
+            int64_t compressed_size = columnar_compress(writer, writer->column, size);
+            if (compressed_size < 0) {
+                return -1;
+            }
+            size = compressed_size;
+            data = writer->compressed;
+        }
+        size_t padding = columnar_align(size) - size;
+        if (fwrite(data, 1, size, writer->file) != size || fwrite(zeros, 1, padding, writer->file) != padding) {
+            return -1;
+        }
+        block_header.column_sizes[c] = to_little_endian64(size);
+    }
+    long block_end = ftell(writer->file);
+    if (block_end < 0 || fseek(writer->file, block_start, SEEK_SET) != 0
+        || fwrite(&block_header, sizeof(block_header), 1, writer->file) != 1
+        || fseek(writer->file, block_end, SEEK_SET) != 0) {
+        return -1;
+    }
+    writer->num_blocks++;
+    writer->num_records += num_subnets;
+    return 0;
+}
+
+/**
+ * @brief Append a batch of subnets to the file
+ * 
+ * @return int 0 if successful, -1 if a block could not be written, in which case the file is invalid
+ */
+int columnar_write(columnar_writer_t* writer, const subnet_t subnets[], size_t num_subnets) {
+    _Static_assert(sizeof(subnet_t) == COLUMNAR_NUM_COLUMNS * sizeof(uint32_t), "subnet_t must be made of 8 fields of 4 bytes");
+    for (size_t i = 0; i < num_subnets && !writer->error; i += COLUMNAR_BLOCK_RECORDS){
+        size_t num_records = num_subnets - i < COLUMNAR_BLOCK_RECORDS ? num_subnets - i : COLUMNAR_BLOCK_RECORDS;
+        writer->error = columnar_write_block(writer, subnets + i, num_records) < 0;
+    }
+    return writer->error ? -1 : 0;
+}
+
+/**
+ * @brief Write the header and close the file
+ * 
+ * @return int 0 if successful, -1 if any write failed
+ */
+int columnar_writer_close(columnar_writer_t* writer) {
+    columnar_header_t header = {.version = to_little_endian(COLUMNAR_VERSION), .compression = to_little_endian(writer->compression),
+        .num_records = to_little_endian64(writer->num_records), .num_blocks = to_little_endian64(writer->num_blocks)};
+    memcpy(header.magic, COLUMNAR_MAGIC, sizeof(header.magic));
+    //a file whose writes failed keeps a zeroed magic, so that it is not mistaken for a valid one
+    if (!writer->error && (fseek(writer->file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, writer->file) != 1)) {
+        writer->error = 1;
+    }
+    free(writer->column);
+    free(writer->compressed);
+    return fclose(writer->file) == 0 && !writer->error ? 0 : -1;
+}
+
+typedef struct {
+    const char* data;
+    size_t size;
+    //copy of the header of the file in native byte order
+    columnar_header_t header;
+} columnar_file_t;
+
+/**
+ * @brief data structure to represent the columns of a block, pointing into the mapped file when it is not compressed
+ */
+typedef struct {
+    uint32_t num_records;
+    const uint32_t* columns[COLUMNAR_NUM_COLUMNS];
+} columnar_block_t;
+
+/**
+ * @brief Map a columnar file in memory
+ * 
+ * @return int 0 if successful, -1 if the file cannot be read, is not a columnar file or has an unknown version
+ */
+int columnar_open(const char* path, columnar_file_t* file) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(columnar_header_t)) {
+        close(fd);
+        return -1;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+    *file = (columnar_file_t) {.data = data, .size = st.st_size};
+    memcpy(&file->header, data, sizeof(columnar_header_t));
+    file->header.version = to_little_endian(file->header.version);
+    file->header.compression = to_little_endian(file->header.compression);
+    file->header.num_records = to_little_endian64(file->header.num_records);
+    file->header.num_blocks = to_little_endian64(file->header.num_blocks);
+    if (memcmp(file->header.magic, COLUMNAR_MAGIC, sizeof(file->header.magic)) != 0 || file->header.version != COLUMNAR_VERSION) {
+        munmap(data, st.st_size);
+        return -1;
+    }
+    return 0;
+}
+
+void columnar_close(columnar_file_t* file) {
+    munmap((void*)file->data, file->size);
+}
+
+/**
+ * @brief Read the block at '*offset' and move the offset to the next block, the first block is at offset 0
+ * 
+ * Compressed columns are decompressed into 'buffer', which must have room for COLUMNAR_NUM_COLUMNS * COLUMNAR_BLOCK_RECORDS
+ * values; it is not used by uncompressed files, whose columns are read in place. Values are little-endian.
+ * 
+ * @return int 1 if a block was read, 0 at the end of the file, -1 if the file is corrupt
+ */
+int columnar_read_block(const columnar_file_t* file, size_t* offset, columnar_block_t* block, uint32_t* buffer) {
+    size_t position = sizeof(columnar_header_t) + *offset;
+    if (position == file->size) {
+        return 0;
+    }
+    if (position > file->size || sizeof(columnar_block_header_t) > file->size - position) {
+        return -1;
+    }
+    const columnar_block_header_t* block_header = (const columnar_block_header_t*)(file->data + position);
+    uint32_t num_records = to_little_endian(block_header->num_records);
+    if (num_records > COLUMNAR_BLOCK_RECORDS) {
+        return -1;
+    }
+    block->num_records = num_records;
+    position += sizeof(columnar_block_header_t);
+    for (int c = 0; c < COLUMNAR_NUM_COLUMNS; c++){
+        uint64_t size = to_little_endian64(block_header->column_sizes[c]);
+        //compared against the remaining length, a size read from the file could wrap around 'position + size'
+        if (size > file->size - position || columnar_align(size) > file->size - position) {
+            return -1;
+        }
+        const char* data = file->data + position;
+        size_t decompressed_size = block->num_records * sizeof(uint32_t);
+        uint32_t* column = buffer + (size_t)c * COLUMNAR_BLOCK_RECORDS;
+        switch (file->header.compression) {
+            case COLUMNAR_UNCOMPRESSED:
+                if (size != decompressed_size) {
+                    return -1;
+                }
+                block->columns[c] = (const uint32_t*)data;
+                break;
+#ifdef HAVE_ZSTD
+            case COLUMNAR_ZSTD:
+                if (ZSTD_decompress(column, decompressed_size, data, size) != decompressed_size) {
+                    return -1;
+                }
+                block->columns[c] = column;
+                break;
+#endif
+#ifdef HAVE_LZ4
+            case COLUMNAR_LZ4:
+                if (LZ4_decompress_safe(data, (char*)column, size, decompressed_size) != (int)decompressed_size) {
+                    return -1;
+                }
+                block->columns[c] = column;
+                break;
+#endif
+            default:
+                (void)column;
+                return -1;
+        }
+        position += columnar_align(size);
+    }
+    *offset = position - sizeof(columnar_header_t);
+    return 1;
+}
+
+/**
+ * @brief Write 10M subnets to a columnar file and read them back
+ */
+void columnar_benchmark() {
+    const char* path = "columnar_benchmark.bin";
+    size_t num_subnets = 10000000;
+    subnet_t* subnets = malloc(num_subnets * sizeof(subnet_t));
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < num_subnets; i++){
+        subnets[i] = subnet_calculator(0x0A000000 + i * 64, 26);
+        checksum += subnets[i].broadcast_address;
+    }
+
+    columnar_writer_t writer;
+    double start = now_seconds();
+    if (columnar_writer_open(path, COLUMNAR_UNCOMPRESSED, &writer) < 0) {
+        free(subnets);
+        return;
+    }
+    columnar_write(&writer, subnets, num_subnets);
+    if (columnar_writer_close(&writer) < 0) {
+        unlink(path);
+        free(subnets);
+        return;
+    }
+    double write_time = now_seconds() - start;
+
+    columnar_file_t file;
+    start = now_seconds();
+    int result = columnar_open(path, &file);
+    assert(result == 0);
+    (void)result;
+    uint64_t read_checksum = 0;
+    size_t offset = 0;
+    columnar_block_t block;
+    while (columnar_read_block(&file, &offset, &block, NULL) > 0) {
+        for (uint32_t i = 0; i < block.num_records; i++){
+            read_checksum += to_little_endian(block.columns[1][i]);
+        }
+    }
+    double read_time = now_seconds() - start;
+    assert(read_checksum == checksum && file.header.num_records == num_subnets);
+    printf("%zu subnets, %.1f bytes/subnet: write %.1f ms, mmap and scan %.1f ms\n", num_subnets, (double)file.size / num_subnets,
+        write_time * 1e3, read_time * 1e3);
+
+    columnar_close(&file);
+    unlink(path);
+    free(subnets);
+}
+
+/*
+ * Compressed index of sorted prefixes
+ * 
+ * The subnets, sorted by network address, are split into blocks of PREFIX_INDEX_BLOCK_SIZE. Within a block each
+ * network address is stored as the difference with the previous one, bit-packed with the number of bits of the largest
+ * difference of the block, followed by the prefix lengths packed in 6 bits. A skip entry per block keeps its first
+ * network address and where its data starts, so that a point lookup is a binary search of the skip entries followed
+ * by the decoding of a single block.
+ */
+#define PREFIX_INDEX_BLOCK_SIZE 128
+#define PREFIX_INDEX_PREFIXLEN_BITS 6
+
+typedef struct {
+    uint32_t first_network_address;
+    uint32_t delta_bits;
+    uint64_t offset;
+} prefix_index_skip_t;
+
+typedef struct {
+    uint64_t num_subnets;
+    uint64_t num_blocks;
+    uint64_t num_words;
+    prefix_index_skip_t* skips;
+    uint32_t* data;
+} prefix_index_t;
+
+/**
+ * @brief Pack 'num_values' values of 'bits' bits into 'words', which must be zeroed
+ */
+void bitpack(const uint32_t values[], size_t num_values, int bits, uint32_t words[]) {
+    for (size_t i = 0; i < num_values; i++){
+        size_t position = i * bits;
+        int shift = position & 31;
+        words[position >> 5] |= values[i] << shift;
+        if (shift + bits > 32) {
+            words[(position >> 5) + 1] |= values[i] >> (32 - shift);
+        }
+    }
+}
+
+/**
+ * @brief Unpack values packed by 'bitpack', 'words' must be followed by one readable word of padding
+ */
+void bitunpack(const uint32_t words[], size_t num_values, int bits, uint32_t values[]) {
+    uint64_t mask = ((uint64_t)1 << bits) - 1;
+    for (size_t i = 0; i < num_values; i++){
+        size_t position = i * bits;
+        uint64_t window = words[position >> 5] | (uint64_t)words[(position >> 5) + 1] << 32;
+        values[i] = window >> (position & 31) & mask;
+    }
+}
+
+size_t bitpacked_words(size_t num_values, int bits) {
+    return (num_values * bits + 31) / 32;
+}
+
+/**
+ * @brief Compress a set of subnets sorted by network address
+ */
+prefix_index_t prefix_index_encode(const compact_subnet_t subnets[], size_t num_subnets) {
+    prefix_index_t index = {.num_subnets = num_subnets, .num_blocks = (num_subnets + PREFIX_INDEX_BLOCK_SIZE - 1) / PREFIX_INDEX_BLOCK_SIZE};
+    index.skips = malloc(index.num_blocks * sizeof(prefix_index_skip_t));
+    //worst case: 32 bits per difference, plus the padding word
+    size_t capacity = bitpacked_words(num_subnets, 32 + PREFIX_INDEX_PREFIXLEN_BITS) + 2 * index.num_blocks + 1;
+    index.data = calloc(capacity, sizeof(uint32_t));
+    uint32_t deltas[PREFIX_INDEX_BLOCK_SIZE], prefixlens[PREFIX_INDEX_BLOCK_SIZE];
+    for (size_t block = 0; block < index.num_blocks; block++){
+        const compact_subnet_t* first = &subnets[block * PREFIX_INDEX_BLOCK_SIZE];
+        size_t num_values = num_subnets - block * PREFIX_INDEX_BLOCK_SIZE < PREFIX_INDEX_BLOCK_SIZE ? num_subnets - block * PREFIX_INDEX_BLOCK_SIZE : PREFIX_INDEX_BLOCK_SIZE;
+        uint32_t max_delta = 0;
+        for (size_t i = 0; i < num_values; i++){
+            assert(i == 0 || first[i].network_address >= first[i - 1].network_address);
+            deltas[i] = i == 0 ? 0 : first[i].network_address - first[i - 1].network_address;
+            prefixlens[i] = first[i].prefixlen;
+            max_delta |= deltas[i];
+        }
+        int delta_bits = max_delta == 0 ? 0 : 32 - __builtin_clz(max_delta);
+        index.skips[block] = (prefix_index_skip_t) {first->network_address, delta_bits, index.num_words};
+        bitpack(deltas, num_values, delta_bits, index.data + index.num_words);
+        index.num_words += bitpacked_words(num_values, delta_bits);
+        bitpack(prefixlens, num_values, PREFIX_INDEX_PREFIXLEN_BITS, index.data + index.num_words);
+        index.num_words += bitpacked_words(num_values, PREFIX_INDEX_PREFIXLEN_BITS);
+    }
+    return index;
+}
+
+void prefix_index_destroy(prefix_index_t* index) {
+    free(index->skips);
+    free(index->data);
+}
+
+/**
+ * @brief Decode one block of the index
+ * 
+ * @return size_t number of subnets of the block
+ */
+size_t prefix_index_decode_block(const prefix_index_t* index, size_t block, compact_subnet_t subnets[]) {
+    uint32_t deltas[PREFIX_INDEX_BLOCK_SIZE], prefixlens[PREFIX_INDEX_BLOCK_SIZE];
+    const prefix_index_skip_t* skip = &index->skips[block];
+    size_t num_values = index->num_subnets - block * PREFIX_INDEX_BLOCK_SIZE < PREFIX_INDEX_BLOCK_SIZE ? index->num_subnets - block * PREFIX_INDEX_BLOCK_SIZE : PREFIX_INDEX_BLOCK_SIZE;
+    const uint32_t* words = index->data + skip->offset;
+    bitunpack(words, num_values, skip->delta_bits, deltas);
+    bitunpack(words + bitpacked_words(num_values, skip->delta_bits), num_values, PREFIX_INDEX_PREFIXLEN_BITS, prefixlens);
+    uint32_t network_address = skip->first_network_address;
+    for (size_t i = 0; i < num_values; i++){
+        network_address += deltas[i];
+        subnets[i] = (compact_subnet_t) {network_address, prefixlens[i]};
+    }
+    return num_values;
+}
+
+/**
+ * @brief Decode the whole index, 'subnets' must have room for 'index->num_subnets' subnets
+ */
+void prefix_index_decode(const prefix_index_t* index, compact_subnet_t subnets[]) {
+    for (size_t block = 0; block < index->num_blocks; block++){
+        prefix_index_decode_block(index, block, subnets + block * PREFIX_INDEX_BLOCK_SIZE);
+    }
+}
+
+/**
+ * @brief Find the first subnet (in order of prefix length) whose network address is 'network_address', decoding a single block
+ * 
+ * @return int64_t position of the subnet in the index, -1 if not found
+ */
+int64_t prefix_index_find(const prefix_index_t* index, uint32_t network_address, compact_subnet_t* subnet) {
+    //last block whose first network address is lower than the one searched, the first occurrence can not be before it
+    size_t low = 0, high = index->num_blocks;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (index->skips[middle].first_network_address < network_address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    compact_subnet_t subnets[PREFIX_INDEX_BLOCK_SIZE];
+    for (size_t block = low > 0 ? low - 1 : 0; block < index->num_blocks && block <= low; block++){
+        size_t num_values = prefix_index_decode_block(index, block, subnets);
+        for (size_t i = 0; i < num_values; i++){
+            if (subnets[i].network_address >= network_address) {
+                if (subnets[i].network_address != network_address) {
+                    return -1;
+                }
+                *subnet = subnets[i];
+                return block * PREFIX_INDEX_BLOCK_SIZE + i;
+            }
+        }
+    }
+    return -1;
+}
+
+#define PREFIX_INDEX_MAGIC "SUBNETI1"
+#define PREFIX_INDEX_VERSION 1
+//number of skip entries or words converted to little-endian at a time
+#define PREFIX_INDEX_IO_CHUNK 4096
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t num_subnets;
+    uint64_t num_blocks;
+    uint64_t num_words;
+} prefix_index_header_t;
+
+/**
+ * @brief Write the index to a file, every field in little-endian byte order like the columnar format
+ * 
+ * @return int 0 if successful, -1 otherwise
+ */
+int prefix_index_write(const prefix_index_t* index, FILE* out) {
+    prefix_index_header_t header = {.version = to_little_endian(PREFIX_INDEX_VERSION), .num_subnets = to_little_endian64(index->num_subnets),
+        .num_blocks = to_little_endian64(index->num_blocks), .num_words = to_little_endian64(index->num_words)};
+    memcpy(header.magic, PREFIX_INDEX_MAGIC, sizeof(header.magic));
+    if (fwrite(&header, sizeof(header), 1, out) != 1) {
+        return -1;
+    }
+    prefix_index_skip_t skips[PREFIX_INDEX_IO_CHUNK];
+    for (size_t i = 0; i < index->num_blocks; i += PREFIX_INDEX_IO_CHUNK){
+        size_t count = index->num_blocks - i < PREFIX_INDEX_IO_CHUNK ? index->num_blocks - i : PREFIX_INDEX_IO_CHUNK;
+        for (size_t j = 0; j < count; j++){
+            const prefix_index_skip_t* skip = &index->skips[i + j];
+            skips[j] = (prefix_index_skip_t) {to_little_endian(skip->first_network_address), to_little_endian(skip->delta_bits), to_little_endian64(skip->offset)};
+        }
+        if (fwrite(skips, sizeof(prefix_index_skip_t), count, out) != count) {
+            return -1;
+        }
+    }
+    uint32_t words[PREFIX_INDEX_IO_CHUNK];
+    for (size_t i = 0; i < index->num_words; i += PREFIX_INDEX_IO_CHUNK){
+        size_t count = index->num_words - i < PREFIX_INDEX_IO_CHUNK ? index->num_words - i : PREFIX_INDEX_IO_CHUNK;
+        for (size_t j = 0; j < count; j++){
+            words[j] = to_little_endian(index->data[i + j]);
+        }
+        if (fwrite(words, sizeof(uint32_t), count, out) != count) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Read an index written by 'prefix_index_write' from the current position of 'in'
+ * 
+ * The fields are converted from little-endian. The sizes of the header are checked against the length of the file and
+ * the blocks against the size of the data, so that a truncated or corrupt file is rejected instead of being decoded out
+ * of bounds.
+ * 
+ * @return int 0 if successful, -1 if the file cannot be read, is not an index or is corrupt
+ */
+int prefix_index_read(prefix_index_t* index, FILE* in) {
+    prefix_index_header_t header;
+    if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, PREFIX_INDEX_MAGIC, sizeof(header.magic)) != 0
+        || to_little_endian(header.version) != PREFIX_INDEX_VERSION) {
+        return -1;
+    }
+    header.num_subnets = to_little_endian64(header.num_subnets);
+    header.num_blocks = to_little_endian64(header.num_blocks);
+    header.num_words = to_little_endian64(header.num_words);
+    long position = ftell(in);
+    if (position < 0 || fseek(in, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    long end = ftell(in);
+    if (end < position || fseek(in, position, SEEK_SET) != 0) {
+        return -1;
+    }
+    uint64_t remaining = end - position;
+    if (header.num_blocks != (header.num_subnets + PREFIX_INDEX_BLOCK_SIZE - 1) / PREFIX_INDEX_BLOCK_SIZE
+        || header.num_blocks > remaining / sizeof(prefix_index_skip_t)
+        || header.num_words > (remaining - header.num_blocks * sizeof(prefix_index_skip_t)) / sizeof(uint32_t)) {
+        return -1;
+    }
+    *index = (prefix_index_t) {header.num_subnets, header.num_blocks, header.num_words,
+        malloc(header.num_blocks * sizeof(prefix_index_skip_t) + 1), calloc(header.num_words + 1, sizeof(uint32_t))};
+    if (index->skips == NULL || index->data == NULL
+        || fread(index->skips, sizeof(prefix_index_skip_t), index->num_blocks, in) != index->num_blocks
+        || fread(index->data, sizeof(uint32_t), index->num_words, in) != index->num_words) {
+        prefix_index_destroy(index);
+        return -1;
+    }
+    for (size_t i = 0; i < index->num_words; i++){
+        index->data[i] = to_little_endian(index->data[i]);
+    }
+    for (size_t block = 0; block < index->num_blocks; block++){
+        prefix_index_skip_t* skip = &index->skips[block];
+        *skip = (prefix_index_skip_t) {to_little_endian(skip->first_network_address), to_little_endian(skip->delta_bits), to_little_endian64(skip->offset)};
+        size_t num_values = index->num_subnets - block * PREFIX_INDEX_BLOCK_SIZE < PREFIX_INDEX_BLOCK_SIZE ? index->num_subnets - block * PREFIX_INDEX_BLOCK_SIZE : PREFIX_INDEX_BLOCK_SIZE;
+        if (skip->delta_bits > 32 || skip->offset > index->num_words
+            || index->num_words - skip->offset < bitpacked_words(num_values, skip->delta_bits) + bitpacked_words(num_values, PREFIX_INDEX_PREFIXLEN_BITS)) {
+            prefix_index_destroy(index);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Size, encoding and decoding speed of an index of 10M sorted subnets
+ */
+void prefix_index_benchmark() {
+    size_t num_subnets = 10000000;
+    compact_subnet_t* subnets = malloc(num_subnets * sizeof(compact_subnet_t));
+    compact_subnet_t* decoded = malloc(num_subnets * sizeof(compact_subnet_t));
+    uint64_t seed = 41, cursor = 0x0A000000;
+    for (size_t i = 0; i < num_subnets; i++){
+        uint64_t r = splitmix64(&seed);
+        int prefixlen = 24 + r % 7;
+        uint64_t size = prefix_table[prefixlen].num_ip_addresses;
+        cursor = ((cursor + size - 1) & ~(size - 1)) + size * (r >> 8 & 1);
+        subnets[i] = compact_subnet_calculator(cursor, prefixlen);
+        cursor += size;
+    }
+
+    double start = now_seconds();
+    prefix_index_t index = prefix_index_encode(subnets, num_subnets);
+    double encode_time = now_seconds() - start;
+    start = now_seconds();
+    prefix_index_decode(&index, decoded);
+    double decode_time = now_seconds() - start;
+    for (size_t i = 0; i < num_subnets; i++){
+        assert(decoded[i].network_address == subnets[i].network_address && decoded[i].prefixlen == subnets[i].prefixlen);
+    }
+
+    size_t num_lookups = 1000000;
+    start = now_seconds();
+    for (size_t i = 0; i < num_lookups; i++){
+        compact_subnet_t found;
+        size_t position = splitmix64(&seed) % num_subnets;
+        int64_t result = prefix_index_find(&index, subnets[position].network_address, &found);
+        assert(result >= 0 && found.network_address == subnets[position].network_address);
+        (void)result;
+    }
+    double lookup_time = now_seconds() - start;
+
+    //round trip through a file, then a truncated copy that must be rejected
+    FILE* file = tmpfile();
+    if (file != NULL) {
+        prefix_index_t read_index;
+        int result = prefix_index_write(&index, file);
+        rewind(file);
+        result |= prefix_index_read(&read_index, file);
+        assert(result == 0 && read_index.num_subnets == index.num_subnets && read_index.num_words == index.num_words);
+        assert(memcmp(read_index.data, index.data, index.num_words * sizeof(uint32_t)) == 0);
+        if (result == 0) {
+            prefix_index_destroy(&read_index);
+        }
+        if (ftruncate(fileno(file), sizeof(prefix_index_header_t) + index.num_blocks * sizeof(prefix_index_skip_t)) == 0) {
+            rewind(file);
+            result = prefix_index_read(&read_index, file);
+            assert(result < 0);
+            if (result == 0) {
+                prefix_index_destroy(&read_index);
+            }
+        }
+        fclose(file);
+    }
+
+    size_t size = index.num_words * sizeof(uint32_t) + index.num_blocks * sizeof(prefix_index_skip_t);
+    printf("%zu subnets: %.2f bytes/subnet (subnet_t: %zu), encode %.0f M subnets/s, decode %.0f M subnets/s, lookup %.0f ns\n",
+        num_subnets, (double)size / num_subnets, sizeof(subnet_t), num_subnets / encode_time / 1e6, num_subnets / decode_time / 1e6,
+        lookup_time / num_lookups * 1e9);
+
+    prefix_index_destroy(&index);
+    free(decoded);
+    free(subnets);
+}
+
+/*
+ * Diff between two allocation plans
+ */
+typedef enum {DIFF_UNCHANGED, DIFF_ADDED, DIFF_REMOVED, DIFF_RESIZED, DIFF_MOVED, NUM_DIFF_KINDS} diff_kind_t;
+
+const char diff_symbols[NUM_DIFF_KINDS] = {'=', '+', '-', '~', '>'};
+
+typedef struct {
+    uint64_t counts[NUM_DIFF_KINDS];
+    //set if the patch could not be written
+    int error;
+} plan_diff_t;
+
+#define DIFF_FLUSH_THRESHOLD (1 << 20)
+
+int format_subnet(char* buffer, uint32_t network_address, int prefixlen) {
+    int length = format_ip_address(buffer, network_address);
+    buffer[length++] = '/';
+    return length + format_decimal(buffer + length, prefixlen);
+}
+
+/**
+ * @brief Append a line to the patch, which is written to 'out' once it reaches DIFF_FLUSH_THRESHOLD bytes
+ * 
+ * @return int 0 if successful, -1 if the patch cannot be written
+ */
+int diff_emit(diff_kind_t kind, const subnet_t* old_subnet, const subnet_t* new_subnet, text_buffer_t* patch, FILE* out) {
+    text_buffer_reserve(patch, 48);
+    char* line = patch->data + patch->length;
+    char* end = line;
+    *end++ = diff_symbols[kind];
+    if (old_subnet != NULL) {
+        *end++ = '\t';
+        end += format_subnet(end, old_subnet->network_address, old_subnet->prefixlen);
+    }
+    if (new_subnet != NULL) {
+        *end++ = '\t';
+        end += format_subnet(end, new_subnet->network_address, new_subnet->prefixlen);
+    }
+    *end++ = '\n';
+    patch->length += end - line;
+    if (patch->length >= DIFF_FLUSH_THRESHOLD) {
+        size_t length = patch->length;
+        patch->length = 0;
+        if (fwrite(patch->data, 1, length, out) != length) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int compare_subnets(const void* a, const void* b) {
+    const subnet_t* subnet_a = a;
+    const subnet_t* subnet_b = b;
+    if (subnet_a->network_address != subnet_b->network_address) {
+        return subnet_a->network_address < subnet_b->network_address ? -1 : 1;
+    }
+    return subnet_a->prefixlen - subnet_b->prefixlen;
+}
+
+/**
+ * @brief Whether 'subnet' is one of 'subnets', which are sorted by network address and prefix length
+ */
+int contains_subnet(const subnet_t subnets[], size_t num_subnets, const subnet_t* subnet) {
+    return bsearch(subnet, subnets, num_subnets, sizeof(subnet_t), compare_subnets) != NULL;
+}
+
+/**
+ * @brief Compare two allocation plans, sorted by network address and prefix length, writing a patch to 'out'
+ * 
+ * Both plans are traversed once, like in a merge, and each change is written as a line of tab-separated fields:
+ * 
+ * +\t<new subnet>             subnet added
+ * -\t<old subnet>             subnet removed
+ * ~\t<old subnet>\t<new subnet>   same network address, different prefix length
+ * >\t<old subnet>\t<new subnet>   different network address, overlapping ranges
+ * 
+ * Plans may contain nested subnets: a subnet present in both plans is always unchanged, the overlap heuristics only
+ * pair subnets that have no exact match on the other side, found with a binary search of the rest of the other plan.
+ * 
+ * Unchanged subnets are only counted. The patch is written in blocks of DIFF_FLUSH_THRESHOLD bytes, so the memory used 
+ * does not depend on the size of the plans. If a write fails, the plans are still compared but 'error' is set and
+ * nothing else is written.
+ */
+plan_diff_t diff_plans(const subnet_t old_subnets[], size_t num_old_subnets, const subnet_t new_subnets[], size_t num_new_subnets, FILE* out) {
+    plan_diff_t diff = {.error = 0};
+    text_buffer_t patch = {0};
+    size_t i = 0, j = 0;
+    while (i < num_old_subnets || j < num_new_subnets) {
+        const subnet_t* old_subnet = i < num_old_subnets ? &old_subnets[i] : NULL;
+        const subnet_t* new_subnet = j < num_new_subnets ? &new_subnets[j] : NULL;
+        diff_kind_t kind;
+        int order = old_subnet != NULL && new_subnet != NULL ? compare_subnets(old_subnet, new_subnet) : 0;
+        if (new_subnet == NULL || (old_subnet != NULL && old_subnet->broadcast_address < new_subnet->network_address)) {
+            kind = DIFF_REMOVED;
+            new_subnet = NULL;
+        } else if (old_subnet == NULL || new_subnet->broadcast_address < old_subnet->network_address) {
+            kind = DIFF_ADDED;
+            old_subnet = NULL;
+        } else if (order == 0) {
+            kind = DIFF_UNCHANGED;
+        } else if (order < 0 && contains_subnet(old_subnets + i + 1, num_old_subnets - i - 1, new_subnet)) {
+            //the new subnet is unchanged further on, e.g. its old parent was removed
+            kind = DIFF_REMOVED;
+            new_subnet = NULL;
+        } else if (order > 0 && contains_subnet(new_subnets + j + 1, num_new_subnets - j - 1, old_subnet)) {
+            kind = DIFF_ADDED;
+            old_subnet = NULL;
+        } else if (old_subnet->network_address == new_subnet->network_address) {
+            kind = DIFF_RESIZED;
+        } else {
+            kind = DIFF_MOVED;
+        }
+        diff.counts[kind]++;
+        if (kind != DIFF_UNCHANGED && !diff.error) {
+            diff.error = diff_emit(kind, old_subnet, new_subnet, &patch, out) < 0;
+        }
+        i += old_subnet != NULL;
+        j += new_subnet != NULL;
+    }
+    if (!diff.error && (fwrite(patch.data, 1, patch.length, out) != patch.length || fflush(out) != 0)) {
+        diff.error = 1;
+    }
+    free(patch.data);
+    return diff;
+}
+
+/**
+ * @brief Compare the subnets of two inventory files, the summary is written to 'summary'
+ * 
+ * The inventories are sorted by the workers of 'pool', the diff itself is a sequential merge as its output is ordered.
+ * 
+ * @return int 0 if successful, -1 if an inventory cannot be loaded or the patch cannot be written
+ */
+int diff_inventories(const char* old_path, const char* new_path, FILE* out, FILE* summary, thread_pool_t* pool) {
+    inventory_t old_inventory, new_inventory;
+    if (load_inventory(old_path, &old_inventory) < 0) {
+        return -1;
+    }
+    if (load_inventory(new_path, &new_inventory) < 0) {
+        free_inventory(&old_inventory);
+        return -1;
+    }
+    parallel_sort(pool, old_inventory.subnets, old_inventory.num_subnets, sizeof(subnet_t), 0, compare_subnets);
+    parallel_sort(pool, new_inventory.subnets, new_inventory.num_subnets, sizeof(subnet_t), 0, compare_subnets);
+    plan_diff_t diff = diff_plans(old_inventory.subnets, old_inventory.num_subnets, new_inventory.subnets, new_inventory.num_subnets, out);
+    if (!diff.error) {
+        fprintf(summary, "unchanged %" PRIu64 ", added %" PRIu64 ", removed %" PRIu64 ", resized %" PRIu64 ", moved %" PRIu64 "\n",
+            diff.counts[DIFF_UNCHANGED], diff.counts[DIFF_ADDED], diff.counts[DIFF_REMOVED], diff.counts[DIFF_RESIZED], diff.counts[DIFF_MOVED]);
+    }
+    free_inventory(&old_inventory);
+    free_inventory(&new_inventory);
+    return diff.error ? -1 : 0;
+}
+
+/**
+ * @brief Diff of two plans of 10M subnets, the second one derived from the first with a few percent of changes
+ */
+void diff_plans_benchmark() {
+    size_t num_subnets = 10000000;
+    subnet_t* old_subnets = malloc(num_subnets * sizeof(subnet_t));
+    subnet_t* new_subnets = malloc((num_subnets + num_subnets / 50) * sizeof(subnet_t));
+    size_t num_new_subnets = 0;
+    uint64_t seed = 42, cursor = 0x0A000000;
+    for (size_t i = 0; i < num_subnets; i++){
+        uint64_t r = splitmix64(&seed);
+        int prefixlen = 26 + r % 5;
+        uint64_t size = prefix_table[prefixlen].num_ip_addresses;
+        cursor = (cursor + 2 * size - 1) & ~(size - 1);
+        old_subnets[i] = subnet_calculator(cursor, prefixlen);
+        switch (r >> 8 & 127) {
+            case 0:     //removed
+                break;
+            case 1:     //resized
+                new_subnets[num_new_subnets++] = subnet_calculator(cursor, prefixlen + 1);
+                break;
+            case 2:     //moved
+                new_subnets[num_new_subnets++] = subnet_calculator(cursor + size / 2, prefixlen + 1);
+                break;
+            case 3:     //added after
+                new_subnets[num_new_subnets++] = old_subnets[i];
+                new_subnets[num_new_subnets++] = subnet_calculator(cursor + size, prefixlen);
+                cursor += size;
+                break;
+            default:
+                new_subnets[num_new_subnets++] = old_subnets[i];
+        }
+        cursor += size;
+    }
+
+    FILE* out = fopen("/dev/null", "w");
+    double start = now_seconds();
+    plan_diff_t diff = diff_plans(old_subnets, num_subnets, new_subnets, num_new_subnets, out);
+    double elapsed = now_seconds() - start;
+    fclose(out);
+    printf("%zu vs %zu subnets in %.3f s: unchanged %" PRIu64 ", added %" PRIu64 ", removed %" PRIu64 ", resized %" PRIu64 ", moved %" PRIu64 "\n",
+        num_subnets, num_new_subnets, elapsed, diff.counts[DIFF_UNCHANGED], diff.counts[DIFF_ADDED], diff.counts[DIFF_REMOVED], diff.counts[DIFF_RESIZED], diff.counts[DIFF_MOVED]);
+
+    free(old_subnets);
+    free(new_subnets);
+}
+
+/*
+ * Reverse DNS zones
+ * 
+ * The PTR records of the addresses of each subnet are written to in-addr.arpa zone files split on /24 or /16
+ * boundaries, e.g. for the zone 2.1.10.in-addr.arpa.
+ * 
+ * 4\tIN\tPTR\t10-1-2-4.example.com.
+ * 
+ * Octets are formatted with a table of their decimal representations, copied 4 bytes at a time.
+ */
+typedef struct {
+    char digits[3];
+    uint8_t length;
+} octet_text_t;
+
+octet_text_t octet_texts[256];
+pthread_once_t octet_texts_once = PTHREAD_ONCE_INIT;
+
+void create_octet_texts() {
+    for (int byte = 0; byte < 256; byte++){
+        char digits[4];
+        octet_texts[byte].length = format_decimal(digits, byte);
+        memcpy(octet_texts[byte].digits, digits, 3);
+    }
+}
+
+/**
+ * @brief Fill 'octet_texts' on first use, once for the whole program so that zones can be generated concurrently
+ */
+void init_octet_texts() {
+    pthread_once(&octet_texts_once, create_octet_texts);
+}
+
+/**
+ * @brief Write an octet, the buffer must have room for 4 characters
+ */
+static inline char* put_octet(char* buffer, unsigned int byte) {
+    memcpy(buffer, &octet_texts[byte], 4);
+    return buffer + octet_texts[byte].length;
+}
+
+/**
+ * @brief data structure to represent the addresses of a subnet that belong to a zone
+ */
+typedef struct {
+    uint32_t zone;
+    uint32_t first_address;
+    uint32_t last_address;
+} ptr_range_t;
+
+#define PTR_FLUSH_THRESHOLD (1 << 20)
+
+/**
+ * @brief Write the origin of a zone, e.g. "2.1.10.in-addr.arpa.", the buffer must have room for 29 characters
+ */
+int format_ptr_origin(char* buffer, uint32_t zone, int zone_prefixlen) {
+    char* end = buffer;
+    for (int shift = 32 - zone_prefixlen; shift < 32; shift += 8){
+        end = put_octet(end, zone >> shift & 0xFF);
+        *end++ = '.';
+    }
+    memcpy(end, "in-addr.arpa.", 13);
+    return end + 13 - buffer;
+}
+
+/**
+ * @brief Write the zone file of the addresses of 'ranges', which belong to the same zone
+ * 
+ * @return int 0 if successful, -1 if a write failed
+ */
+int format_ptr_zone(const ptr_range_t ranges[], size_t num_ranges, int zone_prefixlen, const char* domain, text_buffer_t* text, FILE* out) {
+    size_t domain_length = strlen(domain);
+    char origin[32];
+    origin[format_ptr_origin(origin, ranges[0].zone, zone_prefixlen)] = '\0';
+    text->length = 0;
+    text_buffer_reserve(text, 4 * domain_length + 128);
+    text->length += sprintf(text->data, "$ORIGIN %s\n$TTL 3600\n@\tIN\tSOA\tns1.%s. hostmaster.%s. 1 3600 900 604800 3600\n@\tIN\tNS\tns1.%s.\n",
+        origin, domain, domain, domain);
+
+    size_t max_record_length = 8 + 9 + 16 + domain_length + 2 + 4;
+    for (size_t i = 0; i < num_ranges; i++){
+        for (uint64_t address = ranges[i].first_address; address <= ranges[i].last_address; address++){
+            text_buffer_reserve(text, max_record_length);
+            char* end = text->data + text->length;
+            end = put_octet(end, address & 0xFF);
+            if (zone_prefixlen == 16) {
+                *end++ = '.';
+                end = put_octet(end, address >> 8 & 0xFF);
+            }
+            memcpy(end, "\tIN\tPTR\t", 8);
+            end += 8;
+            for (int shift = 24; shift > 0; shift -= 8){
+                end = put_octet(end, address >> shift & 0xFF);
+                *end++ = '-';
+            }
+            end = put_octet(end, address & 0xFF);
+            *end++ = '.';
+            memcpy(end, domain, domain_length);
+            end += domain_length;
+            *end++ = '.';
+            *end++ = '\n';
+            text->length = end - text->data;
+            if (text->length >= PTR_FLUSH_THRESHOLD) {
+                if (fwrite(text->data, 1, text->length, out) != text->length) {
+                    return -1;
+                }
+                text->length = 0;
+            }
+        }
+    }
+    size_t length = text->length;
+    text->length = 0;
+    return fwrite(text->data, 1, length, out) == length ? 0 : -1;
+}
+
+typedef struct {
+    const ptr_range_t* ranges;
+    const size_t* zone_starts;
+    int zone_prefixlen;
+    const char* domain;
+    const char* directory;
+    int result;
+} ptr_worker_args_t;
+
+void ptr_worker(void* context, size_t begin, size_t end) {
+    ptr_worker_args_t* args = context;
+    text_buffer_t text = {0};
+    for (size_t zone = begin; zone < end; zone++){
+        const ptr_range_t* ranges = &args->ranges[args->zone_starts[zone]];
+        char path[4096];
+        //the origin and the extension take up to 32 characters after the directory
+        int length = snprintf(path, sizeof(path), "%s/", args->directory);
+        if (length < 0 || (size_t)length >= sizeof(path) - 32) {
+            __atomic_store_n(&args->result, -1, __ATOMIC_RELAXED);
+            continue;
+        }
+        length += format_ptr_origin(path + length, ranges[0].zone, args->zone_prefixlen);
+        strcpy(path + length, "zone");
+        FILE* out = fopen(path, "w");
+        if (out == NULL) {
+            __atomic_store_n(&args->result, -1, __ATOMIC_RELAXED);
+            continue;
+        }
+        int result = format_ptr_zone(ranges, args->zone_starts[zone + 1] - args->zone_starts[zone], args->zone_prefixlen, args->domain, &text, out);
+        if (fclose(out) != 0 || result < 0) {
+            __atomic_store_n(&args->result, -1, __ATOMIC_RELAXED);
+        }
+    }
+    free(text.data);
+}
+
+int compare_ptr_ranges(const void* a, const void* b) {
+    const ptr_range_t* range_a = a;
+    const ptr_range_t* range_b = b;
+    if (range_a->zone != range_b->zone) {
+        return range_a->zone < range_b->zone ? -1 : 1;
+    }
+    return (range_a->first_address > range_b->first_address) - (range_a->first_address < range_b->first_address);
+}
+
+/**
+ * @brief Generate the reverse DNS zones of a set of subnets
+ * 
+ * Each zone is written to '<directory>/<origin>zone', e.g. 'zones/2.1.10.in-addr.arpa.zone', and contains the PTR records
+ * of the addresses, from first_address to last_address, of the subnets that belong to it. Overlapping subnets, such as
+ * nested or duplicated ones, are merged so that each address has a single record and each zone is written by a single
+ * worker. Subnets without host addresses (/31 and /32) are skipped. The zones are written in parallel by the workers
+ * of 'pool'.
+ * 
+ * @param zone_prefixlen 24 or 16
+ * @return int64_t number of zones written, -1 if a zone file cannot be created or written, in which case the other
+ * zones are still written
+ */
+int64_t generate_ptr_zones(const subnet_t subnets[], size_t num_subnets, int zone_prefixlen, const char* domain, const char* directory, thread_pool_t* pool) {
+    assert(zone_prefixlen == 24 || zone_prefixlen == 16);
+    init_octet_texts();
+    uint32_t zone_mask = prefix_table[zone_prefixlen].subnet_mask;
+
+    //split the subnets on zone boundaries
+    size_t capacity = num_subnets + 1, num_ranges = 0, num_zones = 0;
+    ptr_range_t* ranges = malloc(capacity * sizeof(ptr_range_t));
+    for (size_t i = 0; i < num_subnets; i++){
+        //the first and last addresses of /31 and /32 wrap around their network address
+        if (subnets[i].prefixlen >= 31 || subnets[i].first_address > subnets[i].last_address) {
+            continue;
+        }
+        for (uint64_t address = subnets[i].first_address; address <= subnets[i].last_address; ){
+            uint64_t zone_last = address | ~zone_mask;
+            uint64_t last = zone_last < subnets[i].last_address ? zone_last : subnets[i].last_address;
+            if (num_ranges == capacity) {
+                capacity *= 2;
+                ranges = realloc(ranges, capacity * sizeof(ptr_range_t));
+            }
+            ranges[num_ranges++] = (ptr_range_t) {address & zone_mask, address, last};
+            address = last + 1;
+        }
+    }
+
+    //group the ranges by zone and merge the overlapping ones
+    parallel_sort(pool, ranges, num_ranges, sizeof(ptr_range_t), 0, compare_ptr_ranges);
+    size_t* zone_starts = malloc((num_ranges + 1) * sizeof(size_t));
+    size_t num_merged = 0;
+    for (size_t i = 0; i < num_ranges; i++){
+        ptr_range_t* previous = num_merged > 0 ? &ranges[num_merged - 1] : NULL;
+        if (previous != NULL && previous->zone == ranges[i].zone && ranges[i].first_address <= previous->last_address) {
+            if (ranges[i].last_address > previous->last_address) {
+                previous->last_address = ranges[i].last_address;
+            }
+            continue;
+        }
+        if (previous == NULL || previous->zone != ranges[i].zone) {
+            zone_starts[num_zones++] = num_merged;
+        }
+        ranges[num_merged++] = ranges[i];
+    }
+    zone_starts[num_zones] = num_merged;
+
+    ptr_worker_args_t args = {ranges, zone_starts, zone_prefixlen, domain, directory, 0};
+    parallel_for(pool, 0, num_zones, 0, ptr_worker, &args);
+    int64_t result = args.result < 0 ? -1 : (int64_t)num_zones;
+    free(ranges);
+    free(zone_starts);
+    return result;
+}
+
+/**
+ * @brief Generate the reverse DNS zones of an inventory file
+ * 
+ * @return int64_t number of zones written, -1 if the inventory cannot be loaded or a zone file cannot be created or written
+ */
+int64_t generate_ptr_zones_from_inventory(const char* inventory_path, int zone_prefixlen, const char* domain, const char* directory, thread_pool_t* pool) {
+    inventory_t inventory;
+    if (load_inventory(inventory_path, &inventory) < 0) {
+        return -1;
+    }
+    parallel_sort(pool, inventory.subnets, inventory.num_subnets, sizeof(subnet_t), 0, compare_subnets);
+    int64_t result = generate_ptr_zones(inventory.subnets, inventory.num_subnets, zone_prefixlen, domain, directory, pool);
+    free_inventory(&inventory);
+    return result;
+}
+
+/**
+ * @brief Formatting speed of PTR records, and generation of the zones of a /12 split into subnets from /20 to /26
+ */
+void ptr_zones_benchmark() {
+    init_octet_texts();
+    ptr_range_t range = {0x0A000000, 0x0A000000, 0x0A00FFFF};
+    text_buffer_t text = {0};
+    FILE* null = fopen("/dev/null", "w");
+    int repetitions = 64;
+    double start = now_seconds();
+    for (int i = 0; i < repetitions; i++){
+        format_ptr_zone(&range, 1, 16, "example.com", &text, null);
+    }
+    double elapsed = now_seconds() - start;
+    fclose(null);
+    free(text.data);
+    printf("format: %.0f M records/s\n", repetitions * 65536.0 / elapsed / 1e6);
+
+    size_t capacity = 1 << 16, num_subnets = 0;
+    subnet_t* subnets = malloc(capacity * sizeof(subnet_t));
+    uint64_t seed = 43, cursor = 0x0A000000, end = 0x0A100000;
+    while (num_subnets < capacity) {
+        int prefixlen = 20 + splitmix64(&seed) % 7;
+        uint64_t size = prefix_table[prefixlen].num_ip_addresses;
+        cursor = (cursor + size - 1) & ~(size - 1);
+        if (cursor + size > end) {
+            break;
+        }
+        subnets[num_subnets++] = subnet_calculator(cursor, prefixlen);
+        cursor += size;
+    }
+    char directory[] = "/tmp/ptr_zones_XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        free(subnets);
+        return;
+    }
+    for (int zone_prefixlen = 16; zone_prefixlen <= 24; zone_prefixlen += 8){
+        start = now_seconds();
+        int64_t num_zones = generate_ptr_zones(subnets, num_subnets, zone_prefixlen, "example.com", directory, default_thread_pool());
+        elapsed = now_seconds() - start;
+        printf("%zu subnets, /%d zones: %" PRId64 " zones in %.3f s\n", num_subnets, zone_prefixlen, num_zones, elapsed);
+        DIR* zones = opendir(directory);
+        if (zones == NULL) {
+            break;
+        }
+        for (struct dirent* entry = readdir(zones); entry != NULL; entry = readdir(zones)){
+            char path[sizeof(directory) + 256];
+            if (entry->d_name[0] != '.') {
+                snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+                unlink(path);
+            }
+        }
+        closedir(zones);
+    }
+    rmdir(directory);
+    free(subnets);
+}
+
+/*
+ * Enumeration of the host addresses of a subnet
+ */
+typedef struct {
+    uint64_t next;
+    uint64_t last;
+    char text[16];
+    int text_length;
+} host_iterator_t;
+
+/**
+ * @brief Iterator over the addresses from 'first_address' to 'last_address' of a subnet, empty for /31 and /32
+ */
+host_iterator_t host_iterator(const subnet_t* subnet) {
+    host_iterator_t iterator = {.next = subnet->first_address, .last = subnet->last_address};
+    //the first and last addresses of /31 and /32 wrap around their network address
+    if (subnet->prefixlen >= 31 || subnet->first_address > subnet->last_address) {
+        iterator.next = 1;
+        iterator.last = 0;
+    }
+    iterator.text_length = format_ip_address(iterator.text, subnet->first_address);
+    return iterator;
+}
+
+/**
+ * @brief Fill 'addresses' with the next host addresses
+ * 
+ * @return size_t number of addresses written, 0 when the iteration is over
+ */
+size_t host_iterator_next(host_iterator_t* iterator, uint32_t addresses[], size_t capacity) {
+    size_t count = iterator->next > iterator->last ? 0 : iterator->last - iterator->next + 1;
+    if (count > capacity) {
+        count = capacity;
+    }
+    uint32_t next = iterator->next;
+    for (size_t i = 0; i < count; i++){
+        addresses[i] = next + i;
+    }
+    iterator->next += count;
+    //keep the text form in sync for 'host_iterator_next_text'
+    if (count > 0 && iterator->next <= iterator->last) {
+        iterator->text_length = format_ip_address(iterator->text, iterator->next);
+    }
+    return count;
+}
+
+/**
+ * @brief Increment the dotted decimal notation of the address, only the last octet is usually modified
+ */
+static inline void host_iterator_increment_text(host_iterator_t* iterator) {
+    if ((iterator->next & 0xFF) == 0) {
+        iterator->text_length = format_ip_address(iterator->text, iterator->next);
+        return;
+    }
+    char* digit = iterator->text + iterator->text_length - 1;
+    while (*digit == '9') {
+        *digit-- = '0';
+    }
+    if (*digit == '.') {
+        //9 -> 10, 99 -> 100
+        digit[1] = '1';
+        iterator->text[iterator->text_length++] = '0';
+    } else {
+        (*digit)++;
+    }
+}
+
+/**
+ * @brief Write the next host addresses to 'buffer' in dotted decimal notation, one per line
+ * 
+ * Rather than formatting every address, the text of the previous one is incremented in place.
+ * 
+ * @return size_t number of characters written, 0 when the iteration is over
+ */
+size_t host_iterator_next_text(host_iterator_t* iterator, char* buffer, size_t capacity) {
+    char* end = buffer;
+    //every line is copied as 16 bytes and then truncated
+    while (iterator->next <= iterator->last && (size_t)(end - buffer) + 17 <= capacity) {
+        memcpy(end, iterator->text, 16);
+        end += iterator->text_length;
+        *end++ = '\n';
+        iterator->next++;
+        if (iterator->next <= iterator->last) {
+            host_iterator_increment_text(iterator);
+        }
+    }
+    return end - buffer;
+}
+
+/**
+ * @brief Enumeration of the hosts of a /8 as integers and as text, compared to formatting every address
+ */
+void host_iterator_benchmark() {
+    subnet_t subnet = subnet_calculator(0x0A000000, 8);
+    size_t capacity = 1 << 16;
+    uint32_t* addresses = malloc(capacity * sizeof(uint32_t));
+    char* text = malloc(capacity * 16);
+
+    host_iterator_t iterator = host_iterator(&subnet);
+    uint64_t checksum = 0, count;
+    double start = now_seconds();
+    while ((count = host_iterator_next(&iterator, addresses, capacity)) > 0) {
+        checksum += addresses[count - 1];
+    }
+    double integer_time = now_seconds() - start;
+
+    iterator = host_iterator(&subnet);
+    uint64_t num_bytes = 0;
+    start = now_seconds();
+    while ((count = host_iterator_next_text(&iterator, text, capacity * 16)) > 0) {
+        num_bytes += count;
+        checksum += text[count - 2];
+    }
+    double text_time = now_seconds() - start;
+
+    uint64_t formatted_bytes = 0;
+    start = now_seconds();
+    for (uint64_t address = subnet.first_address; address <= subnet.last_address; ){
+        char* end = text;
+        for (size_t i = 0; i < capacity && address <= subnet.last_address; i++, address++){
+            end += format_ip_address(end, address);
+            *end++ = '\n';
+        }
+        formatted_bytes += end - text;
+        checksum += end[-2];
+    }
+    double format_time = now_seconds() - start;
+    assert(formatted_bytes == num_bytes);
+
+    uint64_t num_hosts = subnet.last_address - subnet.first_address + 1;
+    printf("%" PRIu64 " hosts: integers %.0f M/s, text %.0f M/s (%.0f MB/s), formatting each address %.0f M/s (checksum %" PRIu64 ")\n", num_hosts,
+        num_hosts / integer_time / 1e6, num_hosts / text_time / 1e6, num_bytes / text_time / 1e6, num_hosts / format_time / 1e6, checksum);
+    free(addresses);
+    free(text);
+}
+
+/*
+ * Pseudo-random permutation of the host addresses of a subnet
+ * 
+ * A balanced Feistel network permutes the indexes of a domain of 4^k values, the smallest one that contains the number 
+ * of hosts, and indexes that fall outside the host range are permuted again until they fall inside (cycle walking). 
+ * As the domain is less than 4 times the number of hosts, fewer than 4 iterations are needed on average. 
+ * Any index can be permuted independently, so workers can be given disjoint ranges of indexes.
+ */
+#define PERMUTATION_ROUNDS 4
+
+typedef struct {
+    uint32_t first_address;
+    uint64_t num_hosts;
+    int half_bits;
+    uint64_t half_mask;
+    uint64_t keys[PERMUTATION_ROUNDS];
+} address_permutation_t;
+
+address_permutation_t address_permutation(const subnet_t* subnet, uint64_t seed) {
+    address_permutation_t permutation = {.first_address = subnet->first_address};
+    //no hosts in /31 and /32, whose first and last addresses wrap around their network address
+    permutation.num_hosts = subnet->prefixlen >= 31 || subnet->first_address > subnet->last_address ? 0 : (uint64_t)subnet->last_address - subnet->first_address + 1;
+    int bits = permutation.num_hosts <= 1 ? 1 : 64 - __builtin_clzll(permutation.num_hosts - 1);
+    permutation.half_bits = (bits + 1) / 2;
+    permutation.half_mask = ((uint64_t)1 << permutation.half_bits) - 1;
+    for (int round = 0; round < PERMUTATION_ROUNDS; round++){
+        permutation.keys[round] = splitmix64(&seed);
+    }
+    return permutation;
+}
+
+static inline uint64_t feistel_permute(const address_permutation_t* permutation, uint64_t index) {
+    uint64_t left = index >> permutation->half_bits;
+    uint64_t right = index & permutation->half_mask;
+    for (int round = 0; round < PERMUTATION_ROUNDS; round++){
+        uint64_t next = left ^ (hash_u64(right ^ permutation->keys[round]) & permutation->half_mask);
+        left = right;
+        right = next;
+    }
+    return left << permutation->half_bits | right;
+}
+
+/**
+ * @brief Host address at position 'index' (lower than the number of hosts) of the permutation
+ */
+static inline uint32_t address_permutation_at(const address_permutation_t* permutation, uint64_t index) {
+    do {
+        index = feistel_permute(permutation, index);
+    } while (index >= permutation->num_hosts);
+    return permutation->first_address + index;
+}
+
+/**
+ * @brief Fill 'addresses' with the host addresses at positions 'first' to 'first + count - 1' of the permutation
+ */
+void address_permutation_fill(const address_permutation_t* permutation, uint64_t first, size_t count, uint32_t addresses[]) {
+    for (size_t i = 0; i < count; i++){
+        addresses[i] = address_permutation_at(permutation, first + i);
+    }
+}
+
+void permutation_worker(void* context, size_t begin, size_t end, void* result) {
+    uint32_t addresses[1024];
+    uint64_t* checksum = result;
+    for (uint64_t first = begin; first < end; first += 1024){
+        size_t count = end - first < 1024 ? end - first : 1024;
+        address_permutation_fill(context, first, count, addresses);
+        for (size_t i = 0; i < count; i++){
+            *checksum += addresses[i];
+        }
+    }
+}
+
+void sum_u64(void* context, void* result, const void* other) {
+    (void)context;
+    *(uint64_t*)result += *(const uint64_t*)other;
+}
+
+/**
+ * @brief Checks that every host of a /16 is visited once, and addresses per second of the permutation of a /8
+ */
+void address_permutation_benchmark() {
+    subnet_t subnet = subnet_calculator(0xC0A80000, 16);
+    address_permutation_t permutation = address_permutation(&subnet, 45);
+    uint8_t* visited = calloc(permutation.num_hosts, 1);
+    for (uint64_t i = 0; i < permutation.num_hosts; i++){
+        uint32_t address = address_permutation_at(&permutation, i);
+        assert(address >= subnet.first_address && address <= subnet.last_address && !visited[address - subnet.first_address]);
+        visited[address - subnet.first_address] = 1;
+    }
+    free(visited);
+
+    subnet = subnet_calculator(0x0A000000, 8);
+    permutation = address_permutation(&subnet, 45);
+    for (int threads = 1; threads <= num_cpus(); threads = next_num_workers(threads)){
+        thread_pool_t* pool = thread_pool_create(threads);
+        uint64_t checksum, zero = 0;
+        double start = now_seconds();
+        parallel_reduce(pool, 0, permutation.num_hosts, 0, &zero, sizeof(uint64_t), permutation_worker, sum_u64, &permutation, &checksum);
+        double elapsed = now_seconds() - start;
+        thread_pool_destroy(pool);
+        //every host is visited once, so the checksum is the sum of the host addresses
+        assert(checksum == (subnet.first_address + (uint64_t)subnet.last_address) * permutation.num_hosts / 2);
+        printf("%" PRIu64 " hosts, %d threads: %.0f M addresses/s\n", permutation.num_hosts, threads, permutation.num_hosts / elapsed / 1e6);
+    }
+}
+
+/*
+ * VRF (tenant) namespaces
+ * 
+ * Every VRF allocates from its own copy of the same pool, so the same addresses can be allocated in different VRFs.
+ * Lookups by (vrf, address) use a binary trie per VRF whose nodes are hash-consed: identical subtrees are stored once 
+ * and shared by every VRF, so the memory used depends on the number of distinct subtrees rather than the number of VRFs. 
+ * Nodes are immutable, an update creates a new path from the root to the modified node and the old path is kept until
+ * the table is compacted.
+ */
+typedef struct {
+    uint32_t children[2];
+    uint32_t present;
+} trie_node_t;
+
+/**
+ * @brief data structure to represent a set of hash-consed trie nodes, node 0 is the empty trie
+ */
+typedef struct {
+    trie_node_t* nodes;
+    size_t num_nodes;
+    size_t capacity;
+    uint32_t* slots;
+    size_t num_slots;
+} interned_trie_t;
+
+interned_trie_t interned_trie_init() {
+    interned_trie_t trie = {.capacity = 1024, .num_slots = 2048};
+    trie.nodes = malloc(trie.capacity * sizeof(trie_node_t));
+    trie.slots = calloc(trie.num_slots, sizeof(uint32_t));
+    trie.nodes[trie.num_nodes++] = (trie_node_t) {{0, 0}, 0};
+    return trie;
+}
+
+void interned_trie_destroy(interned_trie_t* trie) {
+    free(trie->nodes);
+    free(trie->slots);
+}
+
+static inline size_t trie_node_hash(const trie_node_t* node) {
+    return hash_u64(((uint64_t)node->children[0] << 32 | node->children[1]) ^ (uint64_t)node->present << 63);
+}
+
+/**
+ * @brief Find the node with the given children and flag, creating it if it does not exist
+ */
+uint32_t interned_trie_node(interned_trie_t* trie, uint32_t left, uint32_t right, uint32_t present) {
+    trie_node_t node = {{left, right}, present};
+    if (left == 0 && right == 0 && !present) {
+        return 0;
+    }
+    size_t mask = trie->num_slots - 1;
+    for (size_t slot = trie_node_hash(&node) & mask; ; slot = (slot + 1) & mask){
+        uint32_t existing = trie->slots[slot];
+        if (existing == 0) {
+            if (trie->num_nodes == trie->capacity) {
+                trie->capacity *= 2;
+                trie->nodes = realloc(trie->nodes, trie->capacity * sizeof(trie_node_t));
+            }
+            trie->nodes[trie->num_nodes] = node;
+            trie->slots[slot] = trie->num_nodes;
+            //keep the load factor under 1/2
+            if (2 * trie->num_nodes >= trie->num_slots) {
+                free(trie->slots);
+                trie->num_slots *= 2;
+                trie->slots = calloc(trie->num_slots, sizeof(uint32_t));
+                for (uint32_t i = 1; i <= trie->num_nodes; i++){
+                    size_t new_slot = trie_node_hash(&trie->nodes[i]) & (trie->num_slots - 1);
+                    while (trie->slots[new_slot] != 0) {
+                        new_slot = (new_slot + 1) & (trie->num_slots - 1);
+                    }
+                    trie->slots[new_slot] = i;
+                }
+            }
+            return trie->num_nodes++;
+        }
+        const trie_node_t* candidate = &trie->nodes[existing];
+        if (candidate->children[0] == left && candidate->children[1] == right && candidate->present == present) {
+            return existing;
+        }
+    }
+}
+
+/**
+ * @brief Add (present = 1) or remove (present = 0) a prefix from the trie rooted at 'root'
+ * 
+ * @return uint32_t root of the updated trie, 'root' is still valid
+ */
+uint32_t interned_trie_update(interned_trie_t* trie, uint32_t root, uint32_t network_address, int prefixlen, int depth, uint32_t present) {
+    trie_node_t node = trie->nodes[root];
+    if (depth == prefixlen) {
+        return interned_trie_node(trie, node.children[0], node.children[1], present);
+    }
+    int bit = network_address >> (31 - depth) & 1;
+    node.children[bit] = interned_trie_update(trie, node.children[bit], network_address, prefixlen, depth + 1, present);
+    return interned_trie_node(trie, node.children[0], node.children[1], node.present);
+}
+
+/**
+ * @brief Longest prefix of the trie rooted at 'root' that contains 'ip_address'
+ * 
+ * @return int prefix length, -1 if there is none
+ */
+int interned_trie_lookup(const interned_trie_t* trie, uint32_t root, uint32_t ip_address) {
+    int longest = -1;
+    uint32_t node = root;
+    for (int depth = 0; node != 0; depth++){
+        if (trie->nodes[node].present) {
+            longest = depth;
+        }
+        if (depth == 32) {
+            break;
+        }
+        node = trie->nodes[node].children[ip_address >> (31 - depth) & 1];
+    }
+    return longest;
+}
+
+/**
+ * @brief data structure to represent a set of VRFs, numbered from 0 to num_vrfs - 1, allocating from the same pool
+ */
+typedef struct {
+    subnet_t pool;
+    int granularity;
+    size_t num_vrfs;
+    free_space_index_t* pools;
+    uint32_t* roots;
+    interned_trie_t trie;
+} vrf_table_t;
+
+vrf_table_t vrf_table_init(size_t num_vrfs, subnet_t pool, int granularity) {
+    vrf_table_t table = {.pool = pool, .granularity = granularity, .num_vrfs = num_vrfs};
+    //the free space index of a VRF is created by its first allocation
+    table.pools = calloc(num_vrfs, sizeof(free_space_index_t));
+    table.roots = calloc(num_vrfs, sizeof(uint32_t));
+    table.trie = interned_trie_init();
+    return table;
+}
+
+void vrf_table_destroy(vrf_table_t* table) {
+    for (size_t vrf = 0; vrf < table->num_vrfs; vrf++){
+        if (table->pools[vrf].largest_free != NULL) {
+            free_space_index_destroy(&table->pools[vrf]);
+        }
+    }
+    free(table->pools);
+    free(table->roots);
+    interned_trie_destroy(&table->trie);
+}
+
+/**
+ * @brief Allocate the first free block of size /prefixlen in the pool of a VRF
+ * 
+ * @return int 0 if successful, -1 if there is no free block big enough
+ */
+int vrf_allocate(vrf_table_t* table, size_t vrf, int prefixlen, subnet_t* subnet) {
+    assert(vrf < table->num_vrfs);
+    if (table->pools[vrf].largest_free == NULL) {
+        table->pools[vrf] = free_space_index_init(table->pool, table->granularity);
+    }
+    if (free_space_allocate_first(&table->pools[vrf], prefixlen, subnet) < 0) {
+        return -1;
+    }
+    table->roots[vrf] = interned_trie_update(&table->trie, table->roots[vrf], subnet->network_address, subnet->prefixlen, 0, 1);
+    return 0;
+}
+
+/**
+ * @brief Release a block previously allocated in a VRF
+ * 
+ * @return int 0 if successful, -1 if the block was not allocated in the VRF
+ */
+int vrf_release(vrf_table_t* table, size_t vrf, const subnet_t* subnet) {
+    assert(vrf < table->num_vrfs);
+    if (table->pools[vrf].largest_free == NULL || free_space_release(&table->pools[vrf], subnet) < 0) {
+        return -1;
+    }
+    table->roots[vrf] = interned_trie_update(&table->trie, table->roots[vrf], subnet->network_address, subnet->prefixlen, 0, 0);
+    return 0;
+}
+
+/**
+ * @brief Find the subnet allocated in a VRF that contains 'ip_address'
+ * 
+ * @return int 0 if found, -1 otherwise
+ */
+int vrf_lookup(const vrf_table_t* table, size_t vrf, uint32_t ip_address, subnet_t* subnet) {
+    assert(vrf < table->num_vrfs);
+    int prefixlen = interned_trie_lookup(&table->trie, table->roots[vrf], ip_address);
+    if (prefixlen < 0) {
+        return -1;
+    }
+    *subnet = subnet_calculator(ip_address & prefix_table[prefixlen].subnet_mask, prefixlen);
+    return 0;
+}
+
+uint32_t interned_trie_copy(const interned_trie_t* from, uint32_t node, interned_trie_t* to, uint32_t copies[]) {
+    if (node != 0 && copies[node] == 0) {
+        const trie_node_t* n = &from->nodes[node];
+        uint32_t left = interned_trie_copy(from, n->children[0], to, copies);
+        uint32_t right = interned_trie_copy(from, n->children[1], to, copies);
+        copies[node] = interned_trie_node(to, left, right, n->present);
+    }
+    return copies[node];
+}
+
+/**
+ * @brief Free the trie nodes no longer used by any VRF, which are left behind by updates
+ */
+void vrf_table_compact(vrf_table_t* table) {
+    interned_trie_t trie = interned_trie_init();
+    uint32_t* copies = calloc(table->trie.num_nodes, sizeof(uint32_t));
+    for (size_t vrf = 0; vrf < table->num_vrfs; vrf++){
+        table->roots[vrf] = interned_trie_copy(&table->trie, table->roots[vrf], &trie, copies);
+    }
+    free(copies);
+    interned_trie_destroy(&table->trie);
+    table->trie = trie;
+}
+
+uint64_t interned_trie_tree_size(const interned_trie_t* trie, uint32_t node, uint64_t sizes[]) {
+    if (node == 0) {
+        return 0;
+    }
+    if (sizes[node] == 0) {
+        const trie_node_t* n = &trie->nodes[node];
+        sizes[node] = 1 + interned_trie_tree_size(trie, n->children[0], sizes) + interned_trie_tree_size(trie, n->children[1], sizes);
+    }
+    return sizes[node];
+}
+
+/**
+ * @brief 10K VRFs allocating from 192.168.0.0/16 with a few allocation profiles, memory of the shared trie compared to
+ * one trie per VRF, and lookup time
+ */
+void vrf_benchmark() {
+    size_t num_vrfs = 10000;
+    vrf_table_t table = vrf_table_init(num_vrfs, subnet_calculator(0xC0A80000, 16), 24);
+    uint64_t seed = 46, num_allocations = 0;
+    double start = now_seconds();
+    for (size_t vrf = 0; vrf < num_vrfs; vrf++){
+        //tenants are created from 16 profiles, with a few allocations of their own
+        uint64_t profile_seed = splitmix64(&seed) % 16;
+        int num_subnets = 10 + profile_seed % 20;
+        subnet_t subnet;
+        for (int i = 0; i < num_subnets; i++){
+            num_allocations += vrf_allocate(&table, vrf, 20 + splitmix64(&profile_seed) % 5, &subnet) == 0;
+        }
+        for (int i = splitmix64(&seed) % 4; i > 0; i--){
+            num_allocations += vrf_allocate(&table, vrf, 24, &subnet) == 0;
+        }
+    }
+    vrf_table_compact(&table);
+    double build_time = now_seconds() - start;
+
+    uint64_t* sizes = calloc(table.trie.num_nodes, sizeof(uint64_t));
+    uint64_t unshared_nodes = 0;
+    for (size_t vrf = 0; vrf < num_vrfs; vrf++){
+        unshared_nodes += interned_trie_tree_size(&table.trie, table.roots[vrf], sizes);
+    }
+    free(sizes);
+    //each VRF still owns the free space index of its pool, the trie only shares the lookup structure
+    size_t pools_memory = num_vrfs * sizeof(free_space_index_t);
+    for (size_t vrf = 0; vrf < num_vrfs; vrf++){
+        if (table.pools[vrf].largest_free != NULL) {
+            pools_memory += free_space_index_memory(&table.pools[vrf]) - sizeof(free_space_index_t);
+        }
+    }
+
+    size_t num_lookups = 10000000, num_found = 0;
+    start = now_seconds();
+    for (size_t i = 0; i < num_lookups; i++){
+        uint64_t r = splitmix64(&seed);
+        subnet_t subnet;
+        num_found += vrf_lookup(&table, r % num_vrfs, 0xC0A80000 | (r >> 32 & 0xFFFF), &subnet) == 0;
+    }
+    double lookup_time = now_seconds() - start;
+
+    double trie_memory = table.trie.num_nodes * sizeof(trie_node_t) + table.trie.num_slots * sizeof(uint32_t);
+    printf("%zu vrfs, %" PRIu64 " allocations in %.3f s: %zu shared trie nodes (%.2f MB), %" PRIu64 " without sharing (%.2f MB), lookup %.0f ns (%zu found)\n",
+        num_vrfs, num_allocations, build_time, table.trie.num_nodes, trie_memory / 1e6, unshared_nodes, unshared_nodes * sizeof(trie_node_t) / 1e6,
+        lookup_time / num_lookups * 1e9, num_found);
+    printf("per-vrf free space indexes: %.2f MB, total with the shared trie: %.2f MB\n", pools_memory / 1e6, (pools_memory + trie_memory) / 1e6);
+    vrf_table_destroy(&table);
+}
+
+/*
+ * Routing table ingest
+ * 
+ * Prefixes are loaded from the text output of 'show ip bgp' or from MRT TABLE_DUMP/TABLE_DUMP_V2 files (RFC 6396), 
+ * uncompressed, and indexed with 'lpm_table_build'.
+ */
+typedef struct {
+    subnet_t* prefixes;
+    size_t num_prefixes;
+    size_t capacity;
+} rib_t;
+
+#define MRT_TABLE_DUMP 12
+#define MRT_TABLE_DUMP_V2 13
+#define MRT_BGP4MP 16
+#define MRT_BGP4MP_ET 17
+#define MRT_AFI_IPV4 1
+#define MRT_RIB_IPV4_UNICAST 2
+#define MRT_RIB_IPV4_UNICAST_ADDPATH 8
+#define MRT_HEADER_SIZE 12
+
+void rib_add(rib_t* rib, uint32_t network_address, int prefixlen) {
+    if (rib->num_prefixes == rib->capacity) {
+        rib->capacity = rib->capacity == 0 ? 65536 : 2 * rib->capacity;
+        rib->prefixes = realloc(rib->prefixes, rib->capacity * sizeof(subnet_t));
+    }
+    rib->prefixes[rib->num_prefixes++] = subnet_calculator(network_address & prefix_table[prefixlen].subnet_mask, prefixlen);
+}
+
+static inline uint32_t read_be16(const uint8_t* bytes) {
+    return bytes[0] << 8 | bytes[1];
+}
+
+static inline uint32_t read_be32(const uint8_t* bytes) {
+    return (uint32_t)bytes[0] << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3];
+}
+
+/**
+ * @brief Parse the prefixes of the RIB records of an MRT file, other records are skipped
+ * 
+ * @return int 0 if successful, -1 if a record is truncated
+ */
+int parse_mrt(const uint8_t* data, size_t length, rib_t* rib) {
+    size_t offset = 0;
+    while (offset + MRT_HEADER_SIZE <= length) {
+        const uint8_t* header = data + offset;
+        uint32_t type = read_be16(header + 4), subtype = read_be16(header + 6), record_length = read_be32(header + 8);
+        const uint8_t* record = header + MRT_HEADER_SIZE;
+        if (record_length > length - offset - MRT_HEADER_SIZE) {
+            return -1;
+        }
+        if (type == MRT_TABLE_DUMP_V2 && (subtype == MRT_RIB_IPV4_UNICAST || subtype == MRT_RIB_IPV4_UNICAST_ADDPATH)) {
+            //sequence number (4), prefix length (1), prefix (prefix length / 8 rounded up)
+            int prefixlen = record_length >= 5 ? record[4] : 33;
+            if (prefixlen > 32 || 5 + (uint32_t)(prefixlen + 7) / 8 > record_length) {
+                return -1;
+            }
+            uint32_t network_address = 0;
+            for (int i = 0; i < (prefixlen + 7) / 8; i++){
+                network_address |= (uint32_t)record[5 + i] << (24 - 8 * i);
+            }
+            rib_add(rib, network_address, prefixlen);
+        } else if (type == MRT_TABLE_DUMP && subtype == MRT_AFI_IPV4) {
+            //view number (2), sequence number (2), prefix (4), prefix length (1)
+            if (record_length < 9 || record[8] > 32) {
+                return -1;
+            }
+            rib_add(rib, read_be32(record + 4), record[8]);
+        }
+        offset += MRT_HEADER_SIZE + record_length;
+    }
+    return offset == length ? 0 : -1;
+}
+
+/**
+ * @brief Parse the prefixes of the output of 'show ip bgp'
+ * 
+ * The network column starts after the status codes, e.g. "*>i10.0.0.0/8", and is empty in the lines of additional 
+ * paths to the previous prefix. Prefixes without length have the length of their class, e.g. 10.0.0.0 is 10.0.0.0/8,
+ * except the default route 0.0.0.0, which is 0.0.0.0/0.
+ * The rest of the lines (headers, next hops wrapped to the next line, ...) are ignored.
+ */
+void parse_show_ip_bgp(const char* text, size_t length, rib_t* rib) {
+    const char* end = text + length;
+    for (const char* line = text; line < end; ){
+        const char* line_end = memchr(line, '\n', end - line);
+        if (line_end == NULL) {
+            line_end = end;
+        }
+        //status codes: up to 5 characters among letters, '*', '>', '=' and spaces
+        const char* cursor = line;
+        while (cursor < line_end && cursor - line < 5 && !(*cursor >= '0' && *cursor <= '9') && *cursor != '\t'
+            && (*cursor == ' ' || *cursor == '*' || *cursor == '>' || *cursor == '=' || (*cursor >= 'a' && *cursor <= 'z') || (*cursor >= 'A' && *cursor <= 'Z'))) {
+            cursor++;
+        }
+        const char* run = cursor;
+        while (cursor < line_end && is_ipv4_char(*cursor)) {
+            cursor++;
+        }
+        uint32_t network_address;
+        if (cursor > run && cursor - run <= 15 && parse_ipv4_run(run, cursor - run, &network_address)) {
+            int prefixlen;
+            if (cursor < line_end && *cursor == '/') {
+                prefixlen = 0;
+                const char* digits = ++cursor;
+                while (cursor < line_end && *cursor >= '0' && *cursor <= '9' && cursor - digits < 2) {
+                    prefixlen = prefixlen * 10 + (*cursor++ - '0');
+                }
+                if (cursor == digits || prefixlen > 32 || (cursor < line_end && *cursor >= '0' && *cursor <= '9')) {
+                    prefixlen = -1;
+                }
+            } else {
+                prefixlen = network_address == 0 ? 0 : network_address < 0x80000000 ? 8 : network_address < 0xC0000000 ? 16 : 24;
+            }
+            if (prefixlen >= 0) {
+                rib_add(rib, network_address, prefixlen);
+            }
+        }
+        line = line_end + 1;
+    }
+}
+
+/**
+ * @brief Whether a file is compressed (gzip, bzip2, xz or zstd), as RIB dumps are usually published
+ */
+int is_compressed_file(const uint8_t* data, size_t length) {
+    return (length >= 2 && data[0] == 0x1F && data[1] == 0x8B)
+        || (length >= 3 && memcmp(data, "BZh", 3) == 0)
+        || (length >= 6 && memcmp(data, "\xFD" "7zXZ\0", 6) == 0)
+        || (length >= 4 && memcmp(data, "\x28\xB5\x2F\xFD", 4) == 0);
+}
+
+/**
+ * @brief Sort subnets by network address and prefix length with the workers of 'pool' and remove the duplicates
+ * 
+ * Input that is already sorted, as routing table dumps usually are, is only checked.
+ * 
+ * @return size_t number of subnets left at the start of the array
+ */
+size_t sort_unique_subnets(subnet_t subnets[], size_t num_subnets, thread_pool_t* pool) {
+    size_t num_sorted = 1;
+    while (num_sorted < num_subnets && compare_subnets(&subnets[num_sorted - 1], &subnets[num_sorted]) <= 0) {
+        num_sorted++;
+    }
+    if (num_sorted < num_subnets) {
+        parallel_sort(pool, subnets, num_subnets, sizeof(subnet_t), 0, compare_subnets);
+    }
+    size_t num_unique = 0;
+    for (size_t i = 0; i < num_subnets; i++){
+        if (num_unique == 0 || compare_subnets(&subnets[num_unique - 1], &subnets[i]) != 0) {
+            subnets[num_unique++] = subnets[i];
+        }
+    }
+    return num_unique;
+}
+
+/**
+ * @brief Load the prefixes of a routing table file, MRT or text, sorted and without duplicates
+ * 
+ * The file is mapped in memory, it is considered MRT if its first record has a TABLE_DUMP or TABLE_DUMP_V2 type.
+ * Compressed files and MRT files of BGP4MP messages, which contain updates rather than a table, are rejected.
+ * Otherwise it is parsed as text, which never fails: lines without a prefix are skipped.
+ * 
+ * Unsorted prefixes are sorted by the workers of 'pool'.
+ * 
+ * @return int 0 if successful, -1 if the file cannot be read, is compressed, contains BGP4MP messages or is a corrupt
+ * MRT file
+ */
+int load_rib(const char* path, rib_t* rib, thread_pool_t* pool) {
+    *rib = (rib_t) {0};
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0) {
+        close(fd);
+        return -1;
+    }
+    size_t length = file_stat.st_size;
+    const uint8_t* data = length > 0 ? mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+    madvise((void*)data, length, MADV_SEQUENTIAL);
+    int result = 0;
+    uint32_t mrt_type = length >= MRT_HEADER_SIZE ? read_be16(data + 4) : 0;
+    if (is_compressed_file(data, length) || mrt_type == MRT_BGP4MP || mrt_type == MRT_BGP4MP_ET) {
+        result = -1;
+    } else if (mrt_type == MRT_TABLE_DUMP || mrt_type == MRT_TABLE_DUMP_V2) {
+        result = parse_mrt(data, length, rib);
+    } else {
+        parse_show_ip_bgp((const char*)data, length, rib);
+    }
+    if (length > 0) {
+        munmap((void*)data, length);
+    }
+
+    rib->num_prefixes = sort_unique_subnets(rib->prefixes, rib->num_prefixes, pool);
+    return result;
+}
+
+void free_rib(rib_t* rib) {
+    free(rib->prefixes);
+}
+
+void rib_test_cases() {
+    const char* text =
+        "BGP table version is 7, local router ID is 192.0.2.1\n"
+        "Status codes: s suppressed, d damped, h history, * valid, > best, i - internal\n"
+        "Origin codes: i - IGP, e - EGP, ? - incomplete\n"
+        "\n"
+        "   Network          Next Hop            Metric LocPrf Weight Path\n"
+        "*> 0.0.0.0          192.0.2.254                            0 64500 i\n"
+        "*> 10.0.0.0         192.0.2.254              0             0 64500 64501 i\n"
+        "*                   198.51.100.1                           0 64511 64501 i\n"
+        "*>i172.16.0.0       192.0.2.253              0    100      0 64502 i\n"
+        "*> 192.168.1.0      192.0.2.254              0             0 64500 64503 i\n"
+        "*> 203.0.113.128/25\n"
+        "                    192.0.2.254              0             0 64500 64504 i\n"
+        "*> 198.51.100.0/24  192.0.2.254              0             0 64500 64505 i";
+    //MRT header: timestamp (4), type (2), subtype (2), length (4)
+    const uint8_t mrt[] = {
+        //PEER_INDEX_TABLE: collector id, empty view name, no peers
+        0, 0, 0, 0, 0, MRT_TABLE_DUMP_V2, 0, 1, 0, 0, 0, 8, 192, 0, 2, 1, 0, 0, 0, 0,
+        //RIB_IPV4_UNICAST without entries: sequence number, prefix length, prefix, entry count
+        0, 0, 0, 0, 0, MRT_TABLE_DUMP_V2, 0, MRT_RIB_IPV4_UNICAST, 0, 0, 0, 7, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, MRT_TABLE_DUMP_V2, 0, MRT_RIB_IPV4_UNICAST, 0, 0, 0, 8, 0, 0, 0, 1, 8, 10, 0, 0,
+        0, 0, 0, 0, 0, MRT_TABLE_DUMP_V2, 0, MRT_RIB_IPV4_UNICAST_ADDPATH, 0, 0, 0, 8, 0, 0, 0, 1, 8, 10, 0, 0,
+        0, 0, 0, 0, 0, MRT_TABLE_DUMP_V2, 0, MRT_RIB_IPV4_UNICAST, 0, 0, 0, 9, 0, 0, 0, 2, 16, 172, 16, 0, 0,
+        0, 0, 0, 0, 0, MRT_TABLE_DUMP_V2, 0, MRT_RIB_IPV4_UNICAST, 0, 0, 0, 10, 0, 0, 0, 3, 24, 192, 168, 1, 0, 0,
+        0, 0, 0, 0, 0, MRT_TABLE_DUMP_V2, 0, MRT_RIB_IPV4_UNICAST, 0, 0, 0, 11, 0, 0, 0, 4, 25, 203, 0, 113, 128, 0, 0,
+    };
+    subnet_t text_prefixes[] = {
+        subnet_calculator(0, 0),
+        subnet_calculator(0x0A000000, 8),
+        subnet_calculator(0xAC100000, 16),
+        subnet_calculator(0xC0A80100, 24),
+        subnet_calculator(0xC6336400, 24),
+        subnet_calculator(0xCB007180, 25),
+    };
+    subnet_t mrt_prefixes[] = {
+        subnet_calculator(0, 0),
+        subnet_calculator(0x0A000000, 8),
+        subnet_calculator(0xAC100000, 16),
+        subnet_calculator(0xC0A80100, 24),
+        subnet_calculator(0xCB007180, 25),
+    };
+
+    const char* paths[] = {"rib_test_cases.txt", "rib_test_cases.mrt"};
+    const void* contents[] = {text, mrt};
+    size_t lengths[] = {strlen(text), sizeof(mrt)};
+    const subnet_t* expected[] = {text_prefixes, mrt_prefixes};
+    size_t num_expected[] = {sizeof(text_prefixes) / sizeof(subnet_t), sizeof(mrt_prefixes) / sizeof(subnet_t)};
+    for (int i = 0; i < 2; i++){
+        FILE* file = fopen(paths[i], "wb");
+        if (file == NULL) {
+            return;
+        }
+        size_t written = fwrite(contents[i], 1, lengths[i], file);
+        fclose(file);
+        rib_t rib = {0};
+        int result = written == lengths[i] ? load_rib(paths[i], &rib, default_thread_pool()) : -1;
+        unlink(paths[i]);
+        printf("%s: %zu prefixes loaded\n", paths[i], rib.num_prefixes);
+        assert(result == 0 && rib.num_prefixes == num_expected[i]);
+        assert(memcmp(rib.prefixes, expected[i], num_expected[i] * sizeof(subnet_t)) == 0);
+        (void)result;
+        free_rib(&rib);
+    }
+}
+
+/**
+ * @brief Load and index a routing table of 1M prefixes, as 'show ip bgp' text and as MRT TABLE_DUMP_V2
+ */
+void rib_benchmark() {
+    size_t num_prefixes = 1000000;
+    subnet_t* prefixes = malloc(num_prefixes * sizeof(subnet_t));
+    uint64_t seed = 47;
+    for (size_t i = 0; i < num_prefixes; i++){
+        prefixes[i] = from_compact_subnet(random_routing_prefix(splitmix64(&seed)));
+    }
+    num_prefixes = sort_unique_subnets(prefixes, num_prefixes, default_thread_pool());
+
+    const char* text_path = "rib_benchmark.txt";
+    const char* mrt_path = "rib_benchmark.mrt";
+    FILE* text = fopen(text_path, "w");
+    FILE* mrt = fopen(mrt_path, "wb");
+    if (text == NULL || mrt == NULL) {
+        if (text != NULL) {
+            fclose(text);
+            unlink(text_path);
+        }
+        if (mrt != NULL) {
+            fclose(mrt);
+            unlink(mrt_path);
+        }
+        free(prefixes);
+        return;
+    }
+    fprintf(text, "BGP table version is 1, local router ID is 192.0.2.1\n\n   Network          Next Hop            Metric LocPrf Weight Path\n");
+    for (size_t i = 0; i < num_prefixes; i++){
+        char network[20];
+        int network_length = format_subnet(network, prefixes[i].network_address, prefixes[i].prefixlen);
+        network[network_length] = '\0';
+        //long networks push the next hop to the next line
+        fprintf(text, network_length > 16 ? "*> %s\n                    " : "*> %-17s", network);
+        fprintf(text, "192.0.2.254              0             0 64500 %u i\n", 64501 + (unsigned int)i % 1000);
+        if (i % 4 == 0) {
+            fprintf(text, "*                   198.51.100.1                           0 64511 %u i\n", 64501 + (unsigned int)i % 1000);
+        }
+        //RIB_IPV4_UNICAST with one entry: peer index (2), originated time (4), attribute length (2), no attributes
+        uint8_t record[MRT_HEADER_SIZE + 5 + 4 + 2 + 10] = {0, 0, 0, 0, 0, MRT_TABLE_DUMP_V2, 0, MRT_RIB_IPV4_UNICAST};
+        int prefix_bytes = (prefixes[i].prefixlen + 7) / 8;
+        uint32_t record_length = 5 + prefix_bytes + 2 + 8;
+        record[11] = record_length;
+        record[MRT_HEADER_SIZE + 4] = prefixes[i].prefixlen;
+        for (int j = 0; j < prefix_bytes; j++){
+            record[MRT_HEADER_SIZE + 5 + j] = prefixes[i].network_address >> (24 - 8 * j);
+        }
+        record[MRT_HEADER_SIZE + 5 + prefix_bytes + 1] = 1;
+        fwrite(record, 1, MRT_HEADER_SIZE + record_length, mrt);
+    }
+    fclose(text);
+    fclose(mrt);
+
+    const char* paths[] = {text_path, mrt_path};
+    for (int i = 0; i < 2; i++){
+        rib_t rib;
+        double start = now_seconds();
+        int result = load_rib(paths[i], &rib, default_thread_pool());
+        double load_time = now_seconds() - start;
+        lpm_table_t table = lpm_table_build(rib.prefixes, rib.num_prefixes, default_thread_pool());
+        double total_time = now_seconds() - start;
+        assert(result == 0 && rib.num_prefixes == num_prefixes);
+        assert(memcmp(rib.prefixes, prefixes, num_prefixes * sizeof(subnet_t)) == 0);
+        (void)result;
+        printf("%s: %zu prefixes loaded in %.3f s, indexed (%zu intervals) in %.3f s\n", paths[i], rib.num_prefixes, load_time,
+            table.num_intervals, total_time);
+        lpm_table_destroy(&table);
+        free_rib(&rib);
+        unlink(paths[i]);
+    }
+    free(prefixes);
+}
+
+/**
+ * @brief Single versus batched lookups of random addresses in a table of 1M prefixes
+ */
+void lpm_lookup_batch_benchmark() {
+    size_t num_prefixes = 1000000, num_lookups = 10000000, batch_size = 1024;
+    subnet_t* prefixes = malloc(num_prefixes * sizeof(subnet_t));
+    uint32_t* ip_addresses = malloc(num_lookups * sizeof(uint32_t));
+    int32_t* single_owners = malloc(num_lookups * sizeof(int32_t));
+    int32_t* batch_owners = malloc(num_lookups * sizeof(int32_t));
+    uint64_t seed = 48;
+    for (size_t i = 0; i < num_prefixes; i++){
+        prefixes[i] = from_compact_subnet(random_routing_prefix(splitmix64(&seed)));
+    }
+    lpm_table_t table = lpm_table_build(prefixes, num_prefixes, default_thread_pool());
+    for (size_t i = 0; i < num_lookups; i++){
+        ip_addresses[i] = splitmix64(&seed);
+    }
+
+    double start = now_seconds();
+    for (size_t i = 0; i < num_lookups; i++){
+        single_owners[i] = lpm_lookup(&table, ip_addresses[i]);
+    }
+    double single_time = now_seconds() - start;
+    start = now_seconds();
+    for (size_t i = 0; i < num_lookups; i += batch_size){
+        lpm_lookup_batch(&table, ip_addresses + i, num_lookups - i < batch_size ? num_lookups - i : batch_size, batch_owners + i);
+    }
+    double batch_time = now_seconds() - start;
+    assert(memcmp(single_owners, batch_owners, num_lookups * sizeof(int32_t)) == 0);
+
+    printf("%zu prefixes (%zu intervals): single %.1f ns/lookup, batched (groups of %d) %.1f ns/lookup\n", num_prefixes, table.num_intervals,
+        single_time / num_lookups * 1e9, LPM_BATCH_GROUP_SIZE, batch_time / num_lookups * 1e9);
+    lpm_table_destroy(&table);
+    free(batch_owners);
+    free(single_owners);
+    free(ip_addresses);
+    free(prefixes);
+}
+
+/*
+ * Cooperative tasks
+ * 
+ * Tasks are stackless coroutines in the style of protothreads: the body of a task is a function written as straight-line
+ * code between CO_BEGIN and CO_END, which returns to the event loop at every CO_YIELD and is resumed right after it.
+ * As the stack is not preserved, the variables that live across yields must be kept in the task, which is the first
+ * member of a larger structure, and the body can not use 'switch' statements that contain yields.
+ * 
+ * An event loop runs on a single thread, so a server would run one per core; tasks waiting for a file descriptor are
+ * resumed when poll reports it ready.
+ */
+typedef enum {CO_PENDING, CO_DONE} co_status_t;
+
+typedef struct event_loop event_loop_t;
+typedef struct task task_t;
+
+struct task {
+    co_status_t (*run)(task_t* task, event_loop_t* loop);
+    int line;
+    int wait_fd;
+    short wait_events;
+    task_t* next;
+};
+
+#define CO_BEGIN(task) switch ((task)->line) { case 0:
+#define CO_YIELD(task) do { (task)->line = __LINE__; return CO_PENDING; case __LINE__:; } while (0)
+#define CO_WAIT_FD(task, fd, events) do { (task)->wait_fd = (fd); (task)->wait_events = (events); CO_YIELD(task); } while (0)
+#define CO_END(task) } (task)->line = -1; return CO_DONE
+
+#define EVENT_LOOP_POLL_INTERVAL 64
+
+struct event_loop {
+    task_t* head;
+    task_t* tail;
+    struct pollfd* fds;
+    task_t** waiting;
+    size_t num_waiting;
+    size_t capacity;
+};
+
+void task_init(task_t* task, co_status_t (*run)(task_t*, event_loop_t*)) {
+    *task = (task_t) {.run = run, .wait_fd = -1};
+}
+
+void event_loop_spawn(event_loop_t* loop, task_t* task) {
+    task->next = NULL;
+    if (loop->tail != NULL) {
+        loop->tail->next = task;
+    } else {
+        loop->head = task;
+    }
+    loop->tail = task;
+}
+
+/**
+ * @brief Move the tasks whose file descriptor is ready back to the run queue
+ */
+void event_loop_poll(event_loop_t* loop, int timeout) {
+    for (size_t i = 0; i < loop->num_waiting; i++){
+        loop->fds[i] = (struct pollfd) {loop->waiting[i]->wait_fd, loop->waiting[i]->wait_events, 0};
+    }
+    if (poll(loop->fds, loop->num_waiting, timeout) <= 0) {
+        return;
+    }
+    size_t num_waiting = 0;
+    for (size_t i = 0; i < loop->num_waiting; i++){
+        if (loop->fds[i].revents != 0) {
+            loop->waiting[i]->wait_fd = -1;
+            event_loop_spawn(loop, loop->waiting[i]);
+        } else {
+            loop->waiting[num_waiting++] = loop->waiting[i];
+        }
+    }
+    loop->num_waiting = num_waiting;
+}
+
+/**
+ * @brief Run the tasks until all of them are done
+ */
+void event_loop_run(event_loop_t* loop) {
+    unsigned int num_resumed = 0;
+    while (loop->head != NULL || loop->num_waiting > 0) {
+        if (loop->head == NULL) {
+            event_loop_poll(loop, -1);
+            continue;
+        }
+        if (loop->num_waiting > 0 && ++num_resumed % EVENT_LOOP_POLL_INTERVAL == 0) {
+            event_loop_poll(loop, 0);
+        }
+        task_t* task = loop->head;
+        loop->head = task->next;
+        if (loop->head == NULL) {
+            loop->tail = NULL;
+        }
+        if (task->run(task, loop) == CO_DONE) {
+            continue;
+        }
+        if (task->wait_fd >= 0) {
+            if (loop->num_waiting == loop->capacity) {
+                loop->capacity = loop->capacity == 0 ? 16 : 2 * loop->capacity;
+                loop->waiting = realloc(loop->waiting, loop->capacity * sizeof(task_t*));
+                loop->fds = realloc(loop->fds, loop->capacity * sizeof(struct pollfd));
+            }
+            loop->waiting[loop->num_waiting++] = task;
+        } else {
+            event_loop_spawn(loop, task);
+        }
+    }
+}
+
+void event_loop_destroy(event_loop_t* loop) {
+    free(loop->waiting);
+    free(loop->fds);
+}
+
+/**
+ * @brief 'vlsm' as a task that yields every 'yield_interval' subnets
+ * 
+ * The subnets are sorted with a counting sort by prefix length, which can be interrupted, so subnets of the same size 
+ * keep their original order. If the subnets do not fit in the original subnet, 'result' is -1.
+ */
+typedef struct {
+    task_t task;
+    subnet_t original_subnet;
+    subnet_t* subnets;
+    size_t num_subnets;
+    size_t yield_interval;
+    int result;
+    size_t i;
+    size_t since_yield;
+    uint64_t total_num_ip_addresses;
+    size_t offsets[34];
+    subnet_t* sorted;
+} vlsm_job_t;
+
+#define VLSM_JOB_MAYBE_YIELD(job) do { \
+    if (++(job)->since_yield >= (job)->yield_interval) { (job)->since_yield = 0; CO_YIELD(&(job)->task); } \
+} while (0)
+
+co_status_t vlsm_job_run(task_t* task, event_loop_t* loop) {
+    vlsm_job_t* job = (vlsm_job_t*)task;
+    (void)loop;
+    CO_BEGIN(task);
+    memset(job->offsets, 0, sizeof(job->offsets));
+    job->total_num_ip_addresses = 0;
+    for (job->i = 0; job->i < job->num_subnets; job->i++){
+        subnet_t* subnet = &job->subnets[job->i];
+        subnet->prefixlen = calculate_subnet_prefixlen(subnet->num_ip_addresses);
+        job->total_num_ip_addresses += prefix_table[subnet->prefixlen].num_ip_addresses;
+        job->offsets[subnet->prefixlen + 1]++;
+        VLSM_JOB_MAYBE_YIELD(job);
+    }
+    //subnets that do not fit skip the rest of the body, the task still ends through CO_END so that it is never resumed
+    job->result = job->total_num_ip_addresses > prefix_table[job->original_subnet.prefixlen].num_ip_addresses ? -1 : 0;
+
+    for (int prefixlen = 1; prefixlen < 34; prefixlen++){
+        job->offsets[prefixlen] += job->offsets[prefixlen - 1];
+    }
+    for (job->i = 0; job->result == 0 && job->i < job->num_subnets; job->i++){
+        job->sorted[job->offsets[job->subnets[job->i].prefixlen]++] = job->subnets[job->i];
+        VLSM_JOB_MAYBE_YIELD(job);
+    }
+
+    for (job->i = 0; job->result == 0 && job->i < job->num_subnets; job->i++){
+        uint32_t network_address = job->i == 0 ? job->original_subnet.network_address : job->subnets[job->i - 1].next_network;
+        job->subnets[job->i] = subnet_calculator(network_address, job->sorted[job->i].prefixlen);
+        VLSM_JOB_MAYBE_YIELD(job);
+    }
+    CO_END(task);
+}
+
+void vlsm_job_init(vlsm_job_t* job, const subnet_t* original_subnet, subnet_t subnets[], size_t num_subnets, size_t yield_interval) {
+    *job = (vlsm_job_t) {.original_subnet = *original_subnet, .subnets = subnets, .num_subnets = num_subnets, .yield_interval = yield_interval};
+    //allocated (and freed) outside of the event loop, as releasing a large block can take milliseconds
+    job->sorted = malloc(num_subnets * sizeof(subnet_t));
+    task_init(&job->task, vlsm_job_run);
+}
+
+void vlsm_job_destroy(vlsm_job_t* job) {
+    free(job->sorted);
+}
+
+/*
+ * Tasks of 'coroutine_test_cases': a reader waits for a pipe that a writer fills after yielding a few times
+ */
+typedef struct {
+    task_t task;
+    int fd;
+    int num_yields;
+    char* log;
+    size_t* log_length;
+} pipe_task_t;
+
+co_status_t pipe_reader_run(task_t* task, event_loop_t* loop) {
+    pipe_task_t* reader = (pipe_task_t*)task;
+    (void)loop;
+    CO_BEGIN(task);
+    reader->log[(*reader->log_length)++] = 'r';
+    CO_WAIT_FD(task, reader->fd, POLLIN);
+    if (read(reader->fd, &reader->log[*reader->log_length], 1) == 1) {
+        (*reader->log_length)++;
+    }
+    CO_END(task);
+}
+
+co_status_t pipe_writer_run(task_t* task, event_loop_t* loop) {
+    pipe_task_t* writer = (pipe_task_t*)task;
+    (void)loop;
+    CO_BEGIN(task);
+    for (; writer->num_yields > 0; writer->num_yields--){
+        writer->log[(*writer->log_length)++] = 'w';
+        CO_YIELD(task);
+    }
+    if (write(writer->fd, "x", 1) == 1) {
+        writer->log[(*writer->log_length)++] = 'W';
+    }
+    CO_END(task);
+}
+
+void coroutine_test_cases() {
+    int fds[2];
+    if (pipe(fds) < 0) {
+        return;
+    }
+    char log[16];
+    size_t log_length = 0;
+    pipe_task_t reader = {.fd = fds[0], .log = log, .log_length = &log_length};
+    pipe_task_t writer = {.fd = fds[1], .num_yields = 3, .log = log, .log_length = &log_length};
+    task_init(&reader.task, pipe_reader_run);
+    task_init(&writer.task, pipe_writer_run);
+    event_loop_t loop = {0};
+    event_loop_spawn(&loop, &reader.task);
+    event_loop_spawn(&loop, &writer.task);
+    event_loop_run(&loop);
+    event_loop_destroy(&loop);
+    close(fds[0]);
+    close(fds[1]);
+    log[log_length] = '\0';
+    //the reader waits while the writer runs, and only resumes once the byte is in the pipe
+    printf("pipe task log: %s\n", log);
+    assert(strcmp(log, "rwwwWx") == 0 && reader.task.line == -1 && writer.task.line == -1);
+}
+
+/*
+ * Mixed workload: lookups arriving at a fixed rate while large plans are calculated in the same event loop
+ */
+typedef struct {
+    task_t task;
+    const lpm_table_t* table;
+    uint32_t ip_address;
+    int32_t owner;
+    double arrival;
+    double* latency;
+} lookup_request_t;
+
+co_status_t lookup_request_run(task_t* task, event_loop_t* loop) {
+    lookup_request_t* request = (lookup_request_t*)task;
+    (void)loop;
+    CO_BEGIN(task);
+    request->owner = lpm_lookup(request->table, request->ip_address);
+    *request->latency = now_seconds() - request->arrival;
+    CO_END(task);
+}
+
+typedef struct {
+    task_t task;
+    lookup_request_t* requests;
+    double* latencies;
+    size_t num_requests;
+    size_t max_requests;
+    double start;
+    double interval;
+    const lpm_table_t* table;
+    uint64_t seed;
+    const int* num_pending_jobs;
+} request_source_t;
+
+co_status_t request_source_run(task_t* task, event_loop_t* loop) {
+    request_source_t* source = (request_source_t*)task;
+    CO_BEGIN(task);
+    for (;;) {
+        //requests that should have arrived while other tasks were running are spawned now, with their arrival time
+        for (double now = now_seconds(); source->num_requests < source->max_requests
+            && source->start + source->num_requests * source->interval <= now; source->num_requests++){
+            lookup_request_t* request = &source->requests[source->num_requests];
+            *request = (lookup_request_t) {.table = source->table, .ip_address = splitmix64(&source->seed),
+                .arrival = source->start + source->num_requests * source->interval, .latency = &source->latencies[source->num_requests]};
+            task_init(&request->task, lookup_request_run);
+            event_loop_spawn(loop, &request->task);
+        }
+        if (*source->num_pending_jobs == 0 || source->num_requests == source->max_requests) {
+            break;
+        }
+        CO_YIELD(task);
+    }
+    CO_END(task);
+}
+
+typedef struct {
+    vlsm_job_t job;
+    int* num_pending_jobs;
+} counted_vlsm_job_t;
+
+co_status_t counted_vlsm_job_run(task_t* task, event_loop_t* loop) {
+    counted_vlsm_job_t* counted = (counted_vlsm_job_t*)task;
+    co_status_t status = vlsm_job_run(task, loop);
+    if (status == CO_DONE) {
+        (*counted->num_pending_jobs)--;
+    }
+    return status;
+}
+
+int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Latency of lookups, arriving every 5 us, while 8 plans of 256K subnets are calculated, yielding every 
+ * 64 subnets versus running each plan to completion
+ */
+void coroutine_benchmark() {
+    size_t num_jobs = 8, num_subnets = 1 << 18, max_requests = 1 << 20;
+    subnet_t original_subnet = subnet_calculator(0x0A000000, 8);
+    subnet_t* subnets = malloc(num_jobs * num_subnets * sizeof(subnet_t));
+    subnet_t* requested = malloc(num_subnets * sizeof(subnet_t));
+    lookup_request_t* requests = malloc(max_requests * sizeof(lookup_request_t));
+    double* latencies = malloc(max_requests * sizeof(double));
+    uint64_t seed = 49;
+    for (size_t i = 0; i < num_subnets; i++){
+        requested[i].num_ip_addresses = 1 + splitmix64(&seed) % 30;
+    }
+    subnet_t* prefixes = malloc(num_subnets * sizeof(subnet_t));
+    memcpy(prefixes, requested, num_subnets * sizeof(subnet_t));
+    vlsm(&original_subnet, prefixes, num_subnets);
+    lpm_table_t table = lpm_table_build(prefixes, num_subnets, default_thread_pool());
+
+    size_t yield_intervals[] = {64, SIZE_MAX};
+    for (int mode = 0; mode < 2; mode++){
+        event_loop_t loop = {0};
+        int num_pending_jobs = num_jobs;
+        request_source_t source = {.requests = requests, .latencies = latencies, .max_requests = max_requests,
+            .interval = 5e-6, .table = &table, .seed = seed, .num_pending_jobs = &num_pending_jobs};
+        task_init(&source.task, request_source_run);
+        event_loop_spawn(&loop, &source.task);
+        counted_vlsm_job_t jobs[num_jobs];
+        for (size_t j = 0; j < num_jobs; j++){
+            memcpy(subnets + j * num_subnets, requested, num_subnets * sizeof(subnet_t));
+            vlsm_job_init(&jobs[j].job, &original_subnet, subnets + j * num_subnets, num_subnets, yield_intervals[mode]);
+            jobs[j].job.task.run = counted_vlsm_job_run;
+            jobs[j].num_pending_jobs = &num_pending_jobs;
+            event_loop_spawn(&loop, &jobs[j].job.task);
+        }
+        source.start = now_seconds();
+        event_loop_run(&loop);
+        double elapsed = now_seconds() - source.start;
+        event_loop_destroy(&loop);
+
+        for (size_t j = 0; j < num_jobs; j++){
+            assert(jobs[j].job.result == 0 && subnets[j * num_subnets].network_address == original_subnet.network_address);
+            assert(subnets[(j + 1) * num_subnets - 1].network_address == prefixes[num_subnets - 1].network_address);
+            vlsm_job_destroy(&jobs[j].job);
+        }
+        qsort(latencies, source.num_requests, sizeof(double), compare_doubles);
+        size_t n = source.num_requests;
+        printf("%-17s %zu plans in %.3f s, %zu lookups: p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+            mode == 0 ? "yield every 64:" : "run to completion:", num_jobs, elapsed, n, latencies[n / 2] * 1e6, latencies[n * 99 / 100] * 1e6,
+            latencies[n * 999 / 1000] * 1e6, latencies[n - 1] * 1e6);
+    }
+
+    lpm_table_destroy(&table);
+    free(prefixes);
+    free(latencies);
+    free(requests);
+    free(requested);
+    free(subnets);
+}
+
+/**
+ * @brief Scaling of parallel sort, parallel reduce (subnet statistics) and parallel for (workload generation) from 1 
+ * worker up to the number of cpus
+ */
+void thread_pool_benchmark() {
+    size_t num_subnets = 4000000, num_parents = 65536;
+    subnet_t* subnets = malloc(num_subnets * sizeof(subnet_t));
+    subnet_t* sorted = malloc(num_subnets * sizeof(subnet_t));
+    subnet_t* parents = malloc(num_parents * sizeof(subnet_t));
+    subnet_stats_t* parent_stats = malloc(num_parents * sizeof(subnet_stats_t));
+    uint64_t seed = 50;
+    for (size_t i = 0; i < num_subnets; i++){
+        subnets[i] = subnet_calculator(splitmix64(&seed), 24 + splitmix64(&seed) % 9);
+    }
+    for (size_t i = 0; i < num_parents; i++){
+        parents[i] = subnet_calculator(i << 16, 16);
+    }
+    FILE* out = fopen("/dev/null", "w");
+
+    printf("%-8s %8s %10s %8s\n", "workers", "sort", "reduce", "for");
+    double baseline[3];
+    for (int num_workers = 1; num_workers <= num_cpus(); num_workers = next_num_workers(num_workers)){
+        thread_pool_t* pool = thread_pool_create(num_workers);
+        double elapsed[3];
+        memcpy(sorted, subnets, num_subnets * sizeof(subnet_t));
+        double start = now_seconds();
+        parallel_sort(pool, sorted, num_subnets, sizeof(subnet_t), 0, compare_subnets);
+        elapsed[0] = now_seconds() - start;
+        for (size_t i = 1; i < num_subnets; i++){
+            assert(compare_subnets(&sorted[i - 1], &sorted[i]) <= 0);
+        }
+
+        start = now_seconds();
+        subnet_stats_t stats = calculate_subnet_stats(parents, num_parents, sorted, num_subnets, parent_stats, pool);
+        elapsed[1] = now_seconds() - start;
+        assert(stats.num_parents == num_parents);
+        (void)stats;
+
+        start = now_seconds();
+        generate_workload(WORKLOAD_LOGS, 0, 50, num_subnets, out, pool);
+        elapsed[2] = now_seconds() - start;
+        thread_pool_destroy(pool);
+
+        if (num_workers == 1) {
+            memcpy(baseline, elapsed, sizeof(baseline));
+        }
+        printf("%-8d", num_workers);
+        for (int i = 0; i < 3; i++){
+            printf(" %6.0fms (%.1fx)", elapsed[i] * 1e3, baseline[i] / elapsed[i]);
+        }
+        printf("\n");
+    }
+    fclose(out);
+    free(parent_stats);
+    free(parents);
+    free(sorted);
+    free(subnets);
+}
+
+int main(int argc, char const *argv[])
+{
+    if (argc == 3 && strcmp(argv[1], "enrich") == 0) {
+        if (enrich_log(argv[2], stdin, stdout, default_thread_pool()) < 0) {
+            fprintf(stderr, "cannot load inventory %s or write the output\n", argv[2]);
+            return 1;
+        }
+        return 0;
+    }
+    if (argc >= 5 && argc <= 6 && strcmp(argv[1], "generate") == 0) {
+        if (argc == 6 && strcmp(argv[5], "binary") != 0) {
+            fprintf(stderr, "unknown output format %s\n", argv[5]);
+            return 1;
+        }
+        uint64_t count, seed;
+        if (parse_uint64(argv[3], &count) < 0 || parse_uint64(argv[4], &seed) < 0) {
+            fprintf(stderr, "count and seed must be decimal numbers: generate <workload> <count> <seed> [binary]\n");
+            return 1;
+        }
+        for (int kind = WORKLOAD_PREFIXES; kind <= WORKLOAD_RANGES; kind++){
+            if (strcmp(argv[2], workload_names[kind]) == 0) {
+                if (generate_workload(kind, argc == 6, seed, count, stdout, default_thread_pool()) < 0) {
+                    fprintf(stderr, "cannot write the workload\n");
+                    return 1;
+                }
+                return 0;
+            }
+        }
+        fprintf(stderr, "unknown workload %s\n", argv[2]);
+        return 1;
+    }
+    if (argc == 4 && strcmp(argv[1], "diff") == 0) {
+        if (diff_inventories(argv[2], argv[3], stdout, stderr, default_thread_pool()) < 0) {
+            fprintf(stderr, "cannot load inventories %s %s or write the patch\n", argv[2], argv[3]);
+            return 1;
+        }
+        return 0;
+    }
+    if (argc >= 5 && argc <= 6 && strcmp(argv[1], "ptr") == 0) {
+        int zone_prefixlen = argc == 6 ? atoi(argv[5]) : 24;
+        if (zone_prefixlen != 24 && zone_prefixlen != 16) {
+            fprintf(stderr, "zones must be split on /24 or /16\n");
+            return 1;
+        }
+        if (generate_ptr_zones_from_inventory(argv[2], zone_prefixlen, argv[3], argv[4], default_thread_pool()) < 0) {
+            fprintf(stderr, "cannot generate zones of %s in %s\n", argv[2], argv[4]);
+            return 1;
+        }
+        return 0;
+    }
+    if (argc >= 2 && argc <= 3 && strcmp(argv[1], "bench") == 0) {
+        if (run_benchmark_suite(argc == 3 ? argv[2] : NULL) < 0) {
+            fprintf(stderr, "cannot write results to %s\n", argv[2]);
+            return 1;
+        }
+        return 0;
+    }
+
     print_subnet_params(subnet_calculator(151587072, 23));
     // printf("subnet /%d needs to be split into subnets of size /%d to have at least %d subnets\n", 18, calculate_subnet_size(18, 100), 100);
-    // printf("in a subnet /%d it is possible to create %d subnets that contain at least %d ip addresses\n", 21, calculate_num_subnets(21, 50), 50);
+    // printf("in a subnet /%d it is possible to create %" PRIu64 " subnets that contain at least %d ip addresses\n", 21, calculate_num_subnets(21, 50), 50);
     // printf("%d\n", to_int((ip_address_t){9,9,9,0}));
 
     //vlsm_test_cases();
+    //plan_hierarchy_benchmark();
+    //free_space_test_cases();
+    //subnet_stats_benchmark();
+    //enrich_test_cases();
+    //enrich_benchmark();
+    //scan_ipv4_test_cases();
+    //scan_ipv4_benchmark();
+    //acl_benchmark();
+    //static_plan_test_cases();
+    //prefix_table_test_cases();
+    //subnet_calculator_benchmark();
+    //compact_subnet_benchmark();
+    //arena_benchmark();
+    //workload_benchmark();
+    //instrumentation_benchmark();
+    //probes_benchmark();
+    //columnar_benchmark();
+    //prefix_index_benchmark();
+    //diff_plans_benchmark();
+    //ptr_zones_benchmark();
+    //host_iterator_benchmark();
+    //address_permutation_benchmark();
+    //vrf_benchmark();
+    //rib_test_cases();
+    //rib_benchmark();
+    //lpm_lookup_batch_benchmark();
+    //coroutine_test_cases();
+    //coroutine_benchmark();
+    //thread_pool_benchmark();
 
     return 0;
 }